@@ -1,60 +1,68 @@
-/*
- * abort.c
- *
- * Contains output drive disable.
+/*
+ * abort.c
+ *
+ * Contains output drive disable.
  * 
-*/
-
-#include <pic.h>
-#include "globals.h";
-
-// This function, TRG_ABORT (trigger abort) doesn't bother checking to
-// see if any function or cycle is executing.  It will simply force
-// the output STEP ports to off, disabling all STEP lines and switch
-// the reference voltage to the Hold/Rest current value.
-void TRG_ABORT(void)
-{
-	X_ABORT();	// Disable Drive and Timer Interrupts
-	Y_ABORT();  // Disable Drive and Timer Interrupts
-	Z_ABORT();  // Disable Drive and Timer Interrupts
-
-}	// End of TRG_ABORT function
-  
-// This function will disable the X drive and disable the 
-// timer interrupt.  The timer will be cleared so it can be 
-// used again.
-void X_ABORT(void)
-{
-	TMR2IE = 0; 	// Clear TMR2 to PR2 Match Interrupt Enable bit
-	TMR2ON = 0; 	// Turn Timer OFF 
-	X_RESET();		// Set RESET low, disable ENABLE
-	RB1 = 0;		// Turn Step Off	
-	TMR2 = 0x00;	// Clear X drive Timer
-	system_status &= 0b11101111;// X-Drive not running
-}	// End of X_ABORT function
-
-// This function will disable the Y drive and disable the 
-// timer interrupt.  The timer will be cleared so it can be 
-// used again.
-void Y_ABORT(void)
-{
-	TMR4IE = 0; 	// Clear TMR4 to PR4 Match Interrupt Enable bit
-	TMR4ON = 0; 	// Turn Timer OFF 
-	Y_RESET();		// Set RESET low, disable ENABLE
-	RA5 = 0;		// Turn Step Off	
-	TMR4 = 0x00;	// Clear Y drive Timer
-	system_status &= 0b11011111;// Y-Drive not running
-}	 // End of Y_ABORT function
-
-// This function will disable the Z drive and disable the 
-// timer interrupt.  The timer will be cleared so it can be 
-// used again.
-void Z_ABORT(void)
-{
-	TMR6IE = 0; 	// Clear TMR6 to PR6 Match Interrupt Enable bit
-	TMR6ON = 0; 	// Turn Timer OFF 
-	Z_RESET();		// Set RESET low, disable ENABLE
-	RB5 = 0;		// Turn Step Off	
-	TMR6 = 0x00;	// Clear Z drive Timer
-	system_status &= 0b10111111;// Z-Drive not running
-}	// End of Z_ABORT function
\ No newline at end of file
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+// This function, TRG_ABORT (trigger abort) doesn't bother checking to
+// see if any function or cycle is executing.  It will simply force
+// the output STEP ports to off, disabling all STEP lines and switch
+// the reference voltage to the Hold/Rest current value.
+void TRG_ABORT(void)
+{
+	const axis_t *axis;
+
+	for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+		AXIS_ABORT(axis);	// Disable Drive and Timer Interrupts
+	vref_locked = 0;	// Next START sets its own vref (see vref.c)
+
+}	// End of TRG_ABORT function
+  
+// This function will disable the drive of axis and disable the 
+// timer interrupt.  The timer will be cleared so it can be 
+// used again.  The step interrupts write the same registers, the
+// read-modify-writes through the descriptor are done with them off.
+void AXIS_ABORT(const axis_t *axis)
+{
+	GIE = 0;
+	*axis->pie &= ~axis->tmrie; 	// Clear TMRx to PRx Match Interrupt Enable bit
+	*axis->tcon &= ~0x04; 	// Turn Timer OFF (TMRxON)
+	drive_starting &= ~axis->running;	// Not waiting to start (see drive_start.c)
+	GIE = 1;
+	AXIS_RESET(axis);		// Set RESET low, disable ENABLE
+	if(axis->name == 'X')
+	{
+		CCP2CON = 0x00;	// X reference PWM off (see vref.c)
+		xyz_mode = 0;	// Timer2 back to X only (see drive_xyz.c)
+	}
+	else if(axis->name == 'Z')
+	{
+		CCP3CON = 0x00;	// STEP back to RB5 (see drive_pwm.c)
+		Z_pwm_on = 0;
+	}
+	GIE = 0;
+	*axis->port &= ~axis->step;		// Turn Step Off	
+	*axis->tmr = 0x00;	// Clear drive Timer
+	system_status &= ~axis->running;// Drive not running
+	GIE = 1;
+	ramp_on &= ~axis->running;	// Ramp off (see drive_ramp.c)
+}	// End of AXIS_ABORT function
+
+//  This is the serial interface to abort.  The format is:
+//	[0] [1] 'AA', 'AX', 'AY' or 'AZ' - Abort All (XYZ), X, Y or Z
+//  The queued moves are forgotten as well (see motion.c)
+void abort_all(void)
+{
+	MOTION_CLEAR();	// Forget queued moves
+	TRG_ABORT();	// XYZ abort All
+}	// End of abort_all function
+
+void abort_axis(const axis_t *axis)
+{
+	MOTION_CLEAR();	// Forget queued moves
+	AXIS_ABORT(axis);	// X, Y or Z abort
+}	// End of abort_axis function
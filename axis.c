@@ -0,0 +1,54 @@
+/*
+ * axis.c
+ *
+ * The axis descriptors.  The serial commands, the motion scheduler and
+ * the settings find the variables, timer and pins of an axis through
+ * its entry here, so those are written once for X, Y and Z.
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+// The step interrupts (see isr in main.c), RAMP, SCURVE, the limit
+// checks and DRIVE_GO are still written out per axis: they run for
+// every step, where fixed registers and pins are one instruction each
+// and going through the pointers here is several.  The foreground pays
+// that indirection instead, and the entries take flash.
+//
+// This is not a way to add an axis by configuration.  The running and
+// limit bits, AXIS_INDEX (names from 'X' up), the MOTION_ jobs, XYZ_DRIVE
+// and the per axis code above are all fixed at X, Y and Z, a fourth axis
+// needs code in each of them as well as an entry here.
+	const axis_t axes[AXIS_COUNT] = {
+		{
+			'X', 0x10, 0x03, MOTION_DRIVE_X, MOTION_HOME_X,	// X-H RC0, X-FFH RC1
+			&X_location, &X_location_hi, &X_new_location, &X_new_location_hi, &X_hit_location,
+			&X_max_speed, &X_min_speed, &X_accel, &X_scurve_steps, &X_full_near,
+			&X_vref, &X_vref_settle, &X_home_speed, &X_home_phase, &X_home_tries,
+			&X_speed, &X_ramp_steps, &X_curve_index, &X_curve_count,
+			&TMR2, &PR2, &T2CON, &PIE1, 0x02,	// Timer2, TMR2IE
+			&PORTB, 0x02, 0x01, 0x04, 0x08,		// STEP RB1, DIR RB0, HALF RB2, CONTROL RB3
+			0x01								// RESET RA0
+		},
+		{
+			'Y', 0x20, 0x0C, MOTION_DRIVE_Y, MOTION_HOME_Y,	// Y-H RC2, Y-FFH RC3
+			&Y_location, &Y_location_hi, &Y_new_location, &Y_new_location_hi, &Y_hit_location,
+			&Y_max_speed, &Y_min_speed, &Y_accel, &Y_scurve_steps, &Y_full_near,
+			&Y_vref, &Y_vref_settle, &Y_home_speed, &Y_home_phase, &Y_home_tries,
+			&Y_speed, &Y_ramp_steps, &Y_curve_index, &Y_curve_count,
+			&TMR4, &PR4, &T4CON, &PIE3, 0x02,	// Timer4, TMR4IE
+			&PORTA, 0x20, 0x10, 0x40, 0x80,		// STEP RA5, DIR RA4, HALF RA6, CONTROL RA7
+			0x02								// RESET RA1
+		},
+		{
+			'Z', 0x40, 0x30, MOTION_DRIVE_Z, MOTION_HOME_Z,	// Z-H RC4, Z-FFH RC5
+			&Z_location, &Z_location_hi, &Z_new_location, &Z_new_location_hi, &Z_hit_location,
+			&Z_max_speed, &Z_min_speed, &Z_accel, &Z_scurve_steps, &Z_full_near,
+			&Z_vref, &Z_vref_settle, &Z_home_speed, &Z_home_phase, &Z_home_tries,
+			&Z_speed, &Z_ramp_steps, &Z_curve_index, &Z_curve_count,
+			&TMR6, &PR6, &T6CON, &PIE3, 0x08,	// Timer6, TMR6IE
+			&PORTB, 0x20, 0x10, 0x40, 0x80,		// STEP RB5, DIR RB4, HALF RB6, CONTROL RB7
+			0x08								// RESET RA3
+		}
+	};
@@ -0,0 +1,127 @@
+/*
+ * baud.c
+ *
+ * Serial interface baud rate selection.  The host can ask for a faster
+ * rate and must confirm it at the new rate, otherwise the interface
+ * falls back to 19200.
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+// The EUSART is run with SYNC = 0, BRGH = 1, BRG16 = 1 so the rate is:
+//
+//		baud = FOSC / (4 * (SPBRGH:SPBRGL + 1))
+//
+// With the 32 MHz FOSC this gives the following (entry is the number
+// sent with the 'BS' command):
+//
+//	entry	baud		SPBRGH:SPBRGL	actual		error
+//	0		19200		416				19185		-0.08%
+//	1		38400		207				38462		+0.16%
+//	2		57600		138				57554		-0.08%
+//	3		115200		68				115942		+0.64%
+//	4		230400		34				228571		-0.79%
+//	5		250000		31				250000		 0.00%
+//	6		500000		15				500000		 0.00%
+//	7		1000000		7				1000000		 0.00%
+//
+// 460800 is left out, the closest it gets is +2.1%.
+	const unsigned int baud_brg[BAUD_COUNT] = { 416, 207, 138, 68, 34, 31, 15, 7 };
+
+	volatile unsigned char baud_rate = 0;		// Table entry in use
+	volatile bit baud_pending = 0;				// New rate waiting for the host 'BC'
+	volatile bit baud_timeout = 0;				// Set by Timer0 when baud_confirm_ms runs out
+	volatile unsigned int baud_confirm_ms = 0;	// mSec left for the host to confirm (see isr)
+
+// This function, SET_BAUD sets the EUSART to a table entry.  Any frame
+// being received is dropped since it started at the old rate.
+void SET_BAUD(unsigned char rate)
+{
+	RCIE = 0;	// The receiver is idle while the rate changes
+
+	BRGH = 1;	// High speed
+	BRG16 = 1;	// 16-bit baud rate generator
+	SPBRGH = (unsigned char)(baud_brg[rate] >> 8);
+	SPBRGL = (unsigned char)(baud_brg[rate] & 0xff);
+	baud_rate = rate;
+
+	index = 0;	// Start over with the next SER_SOF (see isr in main.c)
+
+	RCIE = 1;
+
+}	// End of SET_BAUD function
+
+// This is the serial interface to change the baud rate.  The format is:
+//	[0] [1] 'BS' - Baud rate Set
+//  [2] table entry (see baud_brg)
+// The reply (the table entry) is sent at the old rate.  Once it is out
+// the new rate is set and the host has BAUD_CONFIRM_MS to send 'BC' at
+// the new rate, otherwise the rate goes back to 19200 (entry 0).
+void write_baud(void)
+{
+	unsigned char rate = rx_arg;
+
+	if(rate >= BAUD_COUNT)
+	{
+		system_status |= 0x03; 	// Invalid command
+								// Error
+		return;
+	}
+
+	SendStart(1);		// Returning 1 char
+	SendByte(rate);
+	SendEnd();			// Reply at the old rate (see ser.c)
+
+	// Let the reply get out before the rate changes.  Polling
+	// eliminates a lockup if something 'bad' happens.
+	for( unsigned int poll = 0; poll < 60000 && tx_head != tx_tail; poll++)
+		HAL_IDLE();
+	for( unsigned int poll = 0; poll < 1000 && !TRMT; poll++)
+		HAL_IDLE();
+
+	SET_BAUD(rate);
+
+	if(rate != 0)
+	{
+		GIE = 0;
+		baud_confirm_ms = BAUD_CONFIRM_MS;	// Counted down by Timer0 (see isr)
+		baud_timeout = 0;
+		GIE = 1;
+		baud_pending = 1;
+	}
+	else
+		baud_pending = 0;	// 19200 needs no confirm
+
+}	// End of write_baud function
+
+// This is the serial interface to confirm a new baud rate.  The format is:
+//	[0] [1] 'BC' - Baud rate Confirm (sent at the new rate)
+// The reply is the table entry in use.
+void confirm_baud(void)
+{
+	baud_pending = 0;	// Keep the new rate
+
+	SendStart(1);		// Returning 1 char
+	SendByte(baud_rate);
+	SendEnd();			// (see ser.c)
+
+}	// End of confirm_baud function
+
+// This function, BAUD_SERVICE is called over and over by main().  If the
+// host did not confirm a new rate in time it goes back to 19200.
+void BAUD_SERVICE(void)
+{
+	if(baud_timeout)
+	{
+		baud_timeout = 0;
+
+		if(baud_pending)
+		{
+			baud_pending = 0;
+			SET_BAUD(0);	// Fall back to 19200
+		}
+	}
+
+}	// End of BAUD_SERVICE function
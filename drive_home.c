@@ -1,105 +1,233 @@
-/*
- * drive_motor.c
- *
- * Functions move XY and Z to Home positions
- * 
-*/
-
-#include <pic.h>
-#include "globals.h";
-
-// This function, X_HOME drives the stepper until X-H (X Home, RC0)
-// goes low.  It will also reset X_location.  X_min_speed will be
-// used as the stepper speed control.
-void X_HOME(void)
-{
-	read_limit_status(); // Check port to see if Home
-	
-	if((limit_status & 0x01) != 0x01) // if X not home
-	{
-		TRG_ABORT();	// Abort all XYZ movement (see abort.c)
-
-		RB0 = 0; 	// Counter clockwise
-		X_START();	// Start Drive HOME
-		
-		if((system_status & 0x08) != 0x08)// Check for period error
-		{
-			// while X not home and not Aborted
-			while( ((limit_status & 0x01) != 0x01) && ((system_status & 0x10) == 0x10)) 
-			{
-				limit_status = ~(PORTC);	 // Check port to see if Home
-			}
-			
-			X_ABORT(); // Disable Drive and interrupts
-		
-			if((limit_status & 0x01) == 0x01)	// If it made it HOME
-				X_new_location = X_location = 0;// set X axis location to X_Home
-		}
-	
-	}			
-
-}	// End of X_HOME function
-
-// This function, Y_HOME drives the stepper until Y-H (Y Home, RC2)
-// goes low.  It will also reset Y_location.  Y_min_speed will be
-// used as the stepper speed control.
-void Y_HOME(void)
-{
-	read_limit_status(); // Check port to see if Home
-	
-	if((limit_status & 0x04) != 0x04) // if Y not home
-	{
-		TRG_ABORT();	// Abort all XYZ movement (see abort.c)
-
-		RA4 = 0; 	// Counter clockwise
-		Y_START();	// Start Drive HOME
-		
-		if((system_status & 0x08) != 0x08)// Check for period error
-		{
-			 // while Y not home and not Aborted
-			while( ((limit_status & 0x04) != 0x04) && ((system_status & 0x20) == 0x20))
-			{
-				limit_status = ~(PORTC);	 // Check port to see if Home
-			}
-			
-			Y_ABORT(); // Disable Drive and interrupts
-			
-			if((limit_status & 0x04) == 0x04)	// If it made it HOME
-				Y_new_location = Y_location = 0;// set Y axis location to Y_Home
-		}
-	
-	}			
-
-}	// End of Y_HOME function
-
-// This function, Z_HOME drives the stepper until Z-H (Z Home, RC4)
-// goes low.  It will also reset Z_location.  Z_min_speed will be
-// used as the stepper speed control.
-void Z_HOME(void)
-{
-	read_limit_status(); // Check port to see if Home
-	
-	if((limit_status & 0x10) != 0x10) // if Z not home
-	{
-		TRG_ABORT();	// Abort all XYZ movement (see abort.c)
-
-		RB4 = 0; 	// Counter clockwise
-		Z_START();	// Start Drive HOME
-		
-		if((system_status & 0x08) != 0x08)// Check for period error
-		{
-			// while Z not home and not Aborted
-			while( ((limit_status & 0x10) != 0x10) && ((system_status & 0x40) == 0x40)) 
-			{
-				limit_status = ~(PORTC);	 // Check port to see if Home
-			}
-			
-			Z_ABORT(); // Disable Drive and interrupts
-			
-			if((limit_status & 0x10) == 0x10)	// If it made it HOME
-				Z_new_location = Z_location = 0;// set Y axis location to Y_Home
-		}
-	}			
-
-}	// End of Z_HOME function
-
+/*
+ * drive_motor.c
+ *
+ * Functions move XY and Z to Home positions
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+// Homing runs the axes asked for at the same time, each on its own
+// timer, in three phases:
+//
+//	HOME_SEEK		towards HOME at *_min_speed, no ramp
+//	HOME_BACKOFF	stop at the switch, drive HOME_BACKOFF_STEPS away
+//	HOME_APPROACH	back to the switch at *_home_speed, set location 0
+//
+// Each phase is stopped at its switch by the step interrupt (see
+// X_LIMIT in system_status.c).  min_speed is the speed a drive starts
+// at from standstill, so the seek can stop dead at the switch from it
+// too, and the slow approach is what sets HOME.  The location is
+// counted all the way and only set to 0 at the end of the approach, an
+// abort or a limit before that leaves the real count.  An axis already
+// on its switch starts with the back off.  With home_z_first X and Y
+// wait in HOME_WAIT until Z is HOME so the tool is up before XY moves.
+	volatile unsigned int X_home_speed = 200;	// X step frequency for the approach
+	volatile unsigned int Y_home_speed = 150;	// Y step frequency for the approach
+	volatile unsigned int Z_home_speed = 100;	// Z step frequency for the approach
+
+	volatile unsigned char X_home_phase = HOME_IDLE;	// X homing phase
+	volatile unsigned char Y_home_phase = HOME_IDLE;	// Y homing phase
+	volatile unsigned char Z_home_phase = HOME_IDLE;	// Z homing phase
+
+	unsigned char X_home_tries = 0;	// X back offs made
+	unsigned char Y_home_tries = 0;	// Y back offs made
+	unsigned char Z_home_tries = 0;	// Z back offs made
+
+	volatile bit home_z_first = 0;	// X and Y wait for Z HOME
+
+// This function, HOME starts homing the axes given as system_status
+// running bits (0x10 X, 0x20 Y, 0x40 Z).  The L297s share DACOUT so
+// the largest Vref of the homing axes is set once here and AXIS_START
+// leaves it (vref_locked).  HOME_DONE finishes the move.
+void HOME(unsigned char running)
+{
+	const axis_t *axis;
+	const axis_t *z = &axes[AXIS_INDEX('Z')];	// The tool (home_z_first)
+	unsigned char vref = 0x00;	// Largest vref of the homing axes
+	unsigned int settle = 0;	// Its settle time (see vref.c)
+
+	TRG_ABORT();	// Abort all XYZ movement (see abort.c)
+
+	for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+	{
+		*axis->home_phase = HOME_IDLE;
+		*axis->home_tries = 0;
+
+		if((running & axis->running) && !(axis->name == 'X' && X_vref_pwm)	// X has its own reference (see vref.c)
+				&& *axis->vref > vref)
+		{
+			vref = *axis->vref;
+			settle = *axis->vref_settle;
+		}
+	}
+
+	// Set L297 vref if needed
+	if( vref && working_vref != vref)
+	{
+		working_vref = vref;	// update working_vref for homing (see vref.c)
+		SET_VREF(settle);		// write vref HW (see vref.c)
+	}
+	vref_locked = 1;
+
+	read_limit_status(); // Check port to see if Home
+
+	if(running & z->running)
+		*z->home_phase = AXIS_HOME_BEGIN(z);
+	for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+		if(axis != z && (running & axis->running))
+			*axis->home_phase = (home_z_first && *z->home_phase != HOME_IDLE) ? HOME_WAIT : AXIS_HOME_BEGIN(axis);
+
+}	// End of HOME function
+
+// This function, HOME_DONE is polled by the motion scheduler (see
+// motion.c) while HOME is running.  It moves each axis through its
+// phases and returns 1 once they are all HOME or aborted.
+unsigned char HOME_DONE(void)
+{
+	const axis_t *axis;
+	const axis_t *z = &axes[AXIS_INDEX('Z')];	// The tool (home_z_first)
+
+	for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+		*axis->home_phase = AXIS_HOME_POLL(axis);
+
+	if(*z->home_phase == HOME_IDLE)	// Z is up, XY can go
+		for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+			if(*axis->home_phase == HOME_WAIT)
+				*axis->home_phase = AXIS_HOME_BEGIN(axis);
+
+	for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+		if(*axis->home_phase != HOME_IDLE)
+			return 0;	// Still driving
+
+	vref_locked = 0;	// AXIS_START sets vref again
+	return 1;
+
+}	// End of HOME_DONE function
+
+// This function, AXIS_HOME_BEGIN starts the seek, or the back off if
+// axis is already on its HOME switch (X-H RC0, Y-H RC2 or Z-H RC4).  It
+// returns the phase started.
+unsigned char AXIS_HOME_BEGIN(const axis_t *axis)
+{
+	if(limit_status & axis->limits & 0b00010101)	// On its HOME switch
+		return AXIS_HOME_BACKOFF(axis);
+
+	PIN_WRITE(axis->port, axis->dir, 0); 	// Counter clockwise
+	AXIS_START(axis, *axis->min_speed);	// Start Drive HOME, no ramp
+	return HOME_SEEK;
+
+}	// End of AXIS_HOME_BEGIN function
+
+// This function, AXIS_HOME_BACKOFF drives axis HOME_BACKOFF_STEPS off
+// its HOME switch.
+unsigned char AXIS_HOME_BACKOFF(const axis_t *axis)
+{
+	long at;	// Off the switch
+
+	AXIS_ABORT(axis);	// Stop here
+
+	at = POSITION(*axis->location_hi, *axis->location) + HOME_BACKOFF_STEPS;
+	*axis->new_location = (unsigned short)at;
+	*axis->new_location_hi = (short)(at >> 16);
+	PIN_WRITE(axis->port, axis->dir, 1); 	// Clockwise
+	ramp_on |= axis->running;		// Stop at new_location (see drive_ramp.c)
+	AXIS_START(axis, *axis->min_speed);	// Start Drive off HOME
+	return HOME_BACKOFF;
+
+}	// End of AXIS_HOME_BACKOFF function
+
+// This function, AXIS_HOME_POLL moves axis on to its next homing phase.
+// It returns the phase the axis is in.  An abort (drive not running)
+// ends the homing without setting its location.  The CCP3 PWM can't
+// step slower than MIN_PWM_SPEED so the Z approach is held to that with
+// Z_step_pwm.
+unsigned char AXIS_HOME_POLL(const axis_t *axis)
+{
+	unsigned char phase = *axis->home_phase;
+	unsigned char home = axis->limits & 0b00010101;	// Its HOME switch
+
+	if(phase == HOME_IDLE || phase == HOME_WAIT)
+		return phase;
+
+	if(limit_hit & home)	// Stopped at its HOME switch (see X_LIMIT in system_status.c)
+	{
+		if(phase == HOME_SEEK)
+			return AXIS_HOME_BACKOFF(axis);
+		if(phase == HOME_APPROACH)
+		{
+			AXIS_ABORT(axis); // Disable Drive and interrupts
+			*axis->new_location = *axis->location = 0;// set axis location to HOME
+			*axis->new_location_hi = *axis->location_hi = 0;
+			return HOME_IDLE;
+		}
+	}
+
+	if(system_status & axis->running)
+		return phase;	// Still driving
+
+	if(phase == HOME_BACKOFF)
+	{
+		if(POSITION(*axis->location_hi, *axis->location) == POSITION(*axis->new_location_hi, *axis->new_location))	// X_RAMP stopped it there
+		{
+			read_limit_status();	// (see system_status.c)
+			if(!(limit_status & home))	// Off its HOME switch
+			{
+				AXIS_ABORT(axis);	// Stop here
+				PIN_WRITE(axis->port, axis->dir, 0); 	// Counter clockwise
+				if(axis->name == 'Z' && Z_step_pwm && *axis->home_speed < MIN_PWM_SPEED)
+					AXIS_START(axis, MIN_PWM_SPEED);	// Slowest CCP3 can step (see drive_pwm.c)
+				else
+					AXIS_START(axis, *axis->home_speed);	// Slow approach, no ramp
+				return HOME_APPROACH;
+			}
+			if(++*axis->home_tries < HOME_TRIES)
+				return AXIS_HOME_BACKOFF(axis);	// Still on its HOME switch, again
+
+			AXIS_ABORT(axis);
+			system_status |= 0x01;	// Can't get off its HOME switch
+									// Error
+			return HOME_IDLE;
+		}
+	}
+
+	AXIS_ABORT(axis);	// Aborted, did not start or stopped at FFH
+	return HOME_IDLE;
+
+}	// End of AXIS_HOME_POLL function
+
+// The following is the serial interface access to set the step
+// frequency X, Y and Z approach their HOME switch with.  The format is:
+//	[0] [1] [2] 'WHX', 'WHY' or 'WHZ': Write HOME approach speed
+//  [3] speed MSB (Hz)
+//  [4] speed LSB
+void write_home_speed(const axis_t *axis)
+{
+	*axis->home_speed = rx_arg;
+}	// End of write_home_speed function
+
+// This is the serial interface to send axes HOME.  The format is:
+//	[0] [1] [2] 'SHA', 'SHX', 'SHY' or 'SHZ' - Send All (XYZ), X, Y or Z HOME
+//  The HOME is queued and runs after the moves before it (see motion.c)
+void send_home_all(void)
+{
+	MOTION_ADD(MOTION_HOME_XYZ);	// XYZ together, Z first with 'WHO'
+}	// End of send_home_all function
+
+void send_home(const axis_t *axis)
+{
+	MOTION_ADD(axis->home_job);
+}	// End of send_home function
+
+// This is the serial interface to set the homing order.  The format is:
+//	[0] [1] [2] 'WHO': Write HOME Order
+//  [3] 0 = X, Y and Z together, 1 = Z first, then X and Y together
+void write_home_order(void)
+{
+	if(rx_arg > 1)
+		system_status |= 0x03; 	// Invalid command
+								// Error
+	else
+		home_z_first = rx_arg;
+}	// End of write_home_order function
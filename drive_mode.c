@@ -1,79 +1,90 @@
-/*
- * drive_mode.c
- *
- * Sets stepper drive modes.
+/*
+ * drive_mode.c
+ *
+ * Sets stepper drive modes.
  * 
-*/
-
-#include <pic.h>
-#include "globals.h";
-
-// This is the default setting for the motor drive.  It is done
-// by selected a high level on the HALF/FULL input.  RESET/Enable
-// will be left low so the L297 drives are off (ABCD = 0000).
-void X_HALF_STEP(void)
-{
-	X_RESET();	// Reset translator to HOME position
-	RB3 = 0; 	// CONTROL: chopper acts on INH1 and INH2
-	RB2 = 1; 	// HALF/FULL set to HALF
-}	//End X_HALF_STEP Function
-
-// This is the default setting for the motor drive.  It is done
-// by selected a high level on the HALF/FULL input.  RESET/Enable
-// will be left low so the L297 drives are off (ABCD = 0000).
-void Y_HALF_STEP(void)
-{
-	Y_RESET();	// Reset translator to HOME position
-	RA7 = 0; 	// CONTROL: chopper acts on INH1 and INH2
-	RA6 = 1; 	// HALF/FULL set to HALF
-}	//End Y_HALF_STEP Function
-
-// This is the default setting for the motor drive.  It is done
-// by selected a high level on the HALF/FULL input.  RESET/Enable
-// will be left low so the L297 drives are off (ABCD = 0000).
-void Z_HALF_STEP(void)
-{
-	Z_RESET();	// Reset translator to HOME position
-	RB7 = 0; 	// CONTROL: chopper acts on INH1 and INH2
-	RB6 = 1; 	// HALF/FULL set to HALF
-}	//End Z_HALF_STEP Function
-	
-// This function, X_RESET will set the X drive to its HOME
-// position upon re-enable (ABCD = 0101).  This position needs 
-// to be known when the motor is run in NORMAL DRIVE MODE 
-// (also called "two-phase-on" drive) or when WAVE DRIVE MODE 
-// (also called "one-phase-on" drive)is used.  This function 
-// will disable the output drives (ABCD = 0000) while the L297
-// is in RESET.
-void X_RESET(void)
-{
-	RA0 = 0;	// Enable and RESET
-	msDelay(1); // Delay for settle
-}	// 	End X_RESET Function
-
-// This function, Y_RESET will set the Y drive to its HOME
-// position upon re-enable (ABCD = 0101).  This position needs 
-// to be known when the motor is run in NORMAL DRIVE MODE 
-// (also called "two-phase-on" drive) or when WAVE DRIVE MODE 
-// (also called "one-phase-on" drive)is used.  This function 
-// will disable the output drives (ABCD = 0000) while the L297
-// is in RESET.
-void Y_RESET(void)
-{
-	RA1 = 0;	// Enable and RESET
-	msDelay(1); // Delay for settle
-}	// 	End Y_RESET Function
-
-// This function, Z_RESET will set the Z drive to its HOME
-// position upon re-enable (ABCD = 0101).  This position needs 
-// to be known when the motor is run in NORMAL DRIVE MODE 
-// (also called "two-phase-on" drive) or when WAVE DRIVE MODE 
-// (also called "one-phase-on" drive)is used.  This function 
-// will disable the output drives (ABCD = 0000) while the L297
-// is in RESET.
-void Z_RESET(void)
-{
-	RA3 = 0;	// Enable and RESET
-	msDelay(1); // Delay for settle
-}	// 	End Z_RESET Function
-	
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+// A drive to a known location can traverse in FULL step and go back
+// to HALF step for the last *_full_near half steps (see AXIS_FULL_TRAVERSE).
+// A FULL step is two half steps so the same speed takes half the STEP
+// pulses and interrupts.  The locations and speeds stay in half steps.
+// 0 is HALF step all the way.
+	volatile unsigned int X_full_near = 0;	// X half steps from X_new_location in HALF step
+	volatile unsigned int Y_full_near = 0;	// Y half steps from Y_new_location in HALF step
+	volatile unsigned int Z_full_near = 0;	// Z half steps from Z_new_location in HALF step
+
+// This function, PIN_WRITE sets (level 1) or clears the pins of port.
+// The step interrupts write the same ports, and a pin through a pointer
+// is a read-modify-write instead of one BSF/BCF, so it is done with the
+// interrupts off.
+void PIN_WRITE(volatile unsigned char *port, unsigned char pins, unsigned char level)
+{
+	GIE = 0;
+	if(level)
+		*port |= pins;
+	else
+		*port &= ~pins;
+	GIE = 1;
+}	// End of PIN_WRITE function
+
+// This is the default setting for the motor drive.  It is done
+// by selected a high level on the HALF/FULL input.  RESET/Enable
+// will be left low so the L297 drives are off (ABCD = 0000).
+void AXIS_HALF_STEP(const axis_t *axis)
+{
+	AXIS_RESET(axis);	// Reset translator to HOME position
+	PIN_WRITE(axis->port, axis->control, 0);	// CONTROL: chopper acts on INH1 and INH2 (RB3 is VREF with X_vref_pwm, see vref.c)
+	PIN_WRITE(axis->port, axis->half, 1);	// HALF/FULL set to HALF
+}	//End AXIS_HALF_STEP Function
+	
+// This function, AXIS_FULL_TRAVERSE sets FULL step for a drive to
+// new_location more than full_near half steps away.  It is called by
+// AXIS_START right after AXIS_HALF_STEP has reset the translator to
+// state 1 (ABCD = 0101), so the FULL steps are two-phase-on (NORMAL
+// DRIVE MODE).  X_RAMP goes back to HALF step full_near half steps out
+// (see drive_ramp.c).  It returns 1 if FULL step was set.
+unsigned char AXIS_FULL_TRAVERSE(const axis_t *axis)
+{
+	unsigned short to_go;	// half steps to new_location
+
+	if(!*axis->full_near)
+		return 0;	// HALF step all the way
+
+	if(*axis->port & axis->dir)	// DIR Clockwise
+		to_go = *axis->new_location - *axis->location;
+	else
+		to_go = *axis->location - *axis->new_location;
+
+	if(to_go <= *axis->full_near)
+		return 0;	// Too short
+
+	PIN_WRITE(axis->port, axis->half, 0);	// HALF/FULL set to FULL
+	return 1;
+}	// End AXIS_FULL_TRAVERSE Function
+
+// This function, AXIS_RESET will set the drive to its HOME
+// position upon re-enable (ABCD = 0101).  This position needs 
+// to be known when the motor is run in NORMAL DRIVE MODE 
+// (also called "two-phase-on" drive) or when WAVE DRIVE MODE 
+// (also called "one-phase-on" drive)is used.  This function 
+// will disable the output drives (ABCD = 0000) while the L297
+// is in RESET.
+void AXIS_RESET(const axis_t *axis)
+{
+	PIN_WRITE(&PORTA, axis->reset, 0);	// Enable and RESET
+	msDelay(1); // Delay for settle
+}	// 	End AXIS_RESET Function
+
+// The following is the serial interface access to set how near
+// new_location a drive goes back to HALF step.  The format is:
+//	[0] [1] [2] 'WNX', 'WNY' or 'WNZ' - Write full step Near distance
+//  [3] full_near MSB (half steps, 0 HALF step only)
+//  [4] full_near LSB
+void write_full_near(const axis_t *axis)
+{
+	*axis->full_near = rx_arg;
+}	// End of write_full_near function
@@ -0,0 +1,143 @@
+/*
+ * drive_pwm.c
+ *
+ * Hardware (CCP PWM) STEP generation.  In this mode the STEP line is
+ * driven by a CCP module at 50% duty so only one timer interrupt per
+ * step is needed (to count it and ramp) instead of one per edge.
+ *
+ * Only the Z STEP line (RB5) can be driven this way, it is the
+ * alternate CCP3 pin (APFCON CCP3SEL).  The X (RB1) and Y (RA5) STEP
+ * lines are not CCP pins on the PIC16F1933 so those drives always
+ * step from the interrupt.
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+	volatile bit Z_step_pwm = 0;	// Z drives step with CCP3 (set by 'WMZ')
+	volatile bit Z_pwm_on = 0;		// CCP3 is driving Z STEP now (see isr in main.c)
+
+// The PWM period is the whole step (high and low) and uses only the
+// timer pre-scale (1:1, 1:4, 1:16 or 1:64), the post-scale just sets
+// how often the interrupt comes.  get_period picks a pre-scale and
+// post-scale for half a step, so the whole step is the same counts at
+// the next pre-scale up when it picked a 1:2 post-scale, or half the
+// counts at the next pre-scale up when it picked 1:1.  That keeps the
+// period at 64 to 255 counts (within 1.6%) from MIN_PWM_SPEED (489 Hz,
+// 1:64 pre-scale) up.  Above MAX_STEP_SPEED the half step of half the
+// speed (rounded) is the whole step at 1:1 pre-scale, up to
+// MAX_PWM_SPEED.  The TxCON value (timer off) is left in period_tcon.
+unsigned char get_pwm_period(unsigned int speed)
+{
+	unsigned char period;
+
+	if((speed > MAX_PWM_SPEED) || (speed < MIN_PWM_SPEED))
+	{
+		system_status |= 0b00001001;	// set Period error status
+		period_tcon = 0b00000011;
+		return 0xFF;
+	}
+
+	if(speed > MAX_STEP_SPEED)
+	{
+		period = get_period((speed + 1) >> 1);	// (see drive_timer.c)
+		period_tcon = 0b00000000;			// 1:1 pre-scale
+		return period;
+	}
+
+	period = get_period(speed);	// (see drive_timer.c)
+	if((period_tcon & 0b01111000) == 0b00000000)	// 1:1 post-scale
+		period >>= 1;								// Half the counts
+
+	period_tcon = (period_tcon & 0b00000011) + 1;	// Next pre-scale, 1:1 post-scale
+	return period;
+
+}	// End of get_pwm_period function
+
+// This function is the same calculation as get_pwm_period but is used
+// by the ramp (see drive_ramp.c) from the interrupt routine.  The
+// TxCON value is left in ramp_tcon.  It does not touch system_status.
+unsigned char get_ramp_pwm_period(unsigned int speed)
+{
+	unsigned char period;
+
+	if(speed < MIN_PWM_SPEED)
+		speed = MIN_PWM_SPEED;	// Slowest period
+	else if(speed > MAX_PWM_SPEED)
+		speed = MAX_PWM_SPEED;	// Fastest period
+
+	if(speed > MAX_STEP_SPEED)
+	{
+		period = get_ramp_period((speed + 1) >> 1);	// (see drive_timer.c)
+		ramp_tcon = 0b00000000;					// 1:1 pre-scale
+		return period;
+	}
+
+	period = get_ramp_period(speed);	// (see drive_timer.c)
+	if((ramp_tcon & 0b01111000) == 0b00000000)	// 1:1 post-scale
+		period >>= 1;							// Half the counts
+
+	ramp_tcon = (ramp_tcon & 0b00000011) + 1;	// Next pre-scale, 1:1 post-scale
+	return period;
+
+}	// End of get_ramp_pwm_period function
+
+// This function, Z_PWM_START sets CCP3 up to drive Z STEP (RB5) from
+// Timer6 at speed.  AXIS_START turns it on with the timer.
+void Z_PWM_START(unsigned int speed)
+{
+	APFCON |= 0b01000000;		// CCP3SEL, CCP3/P3A on RB5
+	CCPTMRS0 = (CCPTMRS0 & 0b11001111) | 0b00100000;	// C3TSEL, CCP3 PWM from Timer6
+
+	PR6 = get_pwm_period(speed); // Set Timer6 Period (whole step)
+	T6CON = period_tcon; // Set Timer6 pre-scale (Off)
+	CCPR3L = (PR6 >> 1) + 1;	// 50% duty (DC3B = 0)
+
+}	// End of Z_PWM_START function
+
+// This function, Z_PWM_STEP is called by the Z step interrupt (see
+// main.c) when Z_pwm_on is set.  The interrupt comes at the start of
+// each PWM period, which is where CCP3 drives STEP high (the L297
+// steps on the rising edge), so every interrupt is one step.  A drive
+// to Z_new_location is stopped by Z_RAMP, right at the step that gets
+// there, and a drive on to a limit switch here, at the step that made
+// it, since the PWM would keep stepping until AXIS_DRIVE_DONE is polled.
+// Unlike the interrupt STEP (see main.c), which checks Z_LIMIT before
+// each step, CCP3 has already made the step that closed the switch, so
+// in this mode Z stops one step past it (see the notes in ser.c).
+void Z_PWM_STEP(void)
+{
+	if(RB4)	// Z DIR Clockwise
+	{
+		if(!++Z_location) // if moving away from home
+			Z_location_hi++;	// Carry (see drive_start.c)
+	}
+	else if(!Z_location--) // if moving towards home
+		Z_location_hi--;	// Borrow
+	location_seq++;	// (see LOCATION in drive_start.c)
+
+	if(Z_LIMIT())	// The step made a switch (see system_status.c)
+	{
+		CCP3CON = 0x00;	// STEP back to RB5 (low)
+		return;			// AXIS_DRIVE_DONE finishes
+	}
+
+	if(ramp_on & 0x40)
+		Z_RAMP();	// Update speed, stops at Z_new_location (see drive_ramp.c)
+
+}	// End of Z_PWM_STEP function
+
+// The following is the serial interface access to select how the
+// Z-Drive STEP line is made.  The format is:
+//	[0] [1] [2] 'WMZ' - Write Z step Mode
+//  [3] 0 = STEP edges from the Timer6 interrupt (default)
+//		1 = STEP from CCP3 PWM, one interrupt per step
+// The PWM mode needs Z_min_speed of at least MIN_PWM_SPEED (489 Hz)
+// otherwise the Period error is set when the drive starts.  The mode
+// is used from the next Z drive or home on.  In this mode Z stops one
+// step past a limit switch (see Z_PWM_STEP).
+void write_Z_step_mode(void)
+{
+	Z_step_pwm = (rx_arg != 0);
+}	// End of write_Z_step_mode function
@@ -0,0 +1,423 @@
+/*
+ * drive_ramp.c
+ *
+ * Acceleration and deceleration (ramp) of the stepper drives.
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+	volatile unsigned int X_accel = 10;		// X axis step frequency change per step (Hz/step)
+	volatile unsigned int Y_accel = 10;		// Y axis step frequency change per step (Hz/step)
+	volatile unsigned int Z_accel = 5;		// Z axis step frequency change per step (Hz/step)
+
+	volatile unsigned int X_speed = 0;		// X axis step frequency currently running
+	volatile unsigned int Y_speed = 0;		// Y axis step frequency currently running
+	volatile unsigned int Z_speed = 0;		// Z axis step frequency currently running
+
+	volatile unsigned int X_ramp_steps = 0;	// X steps spent accelerating (steps needed to stop)
+	volatile unsigned int Y_ramp_steps = 0;	// Y steps spent accelerating (steps needed to stop)
+	volatile unsigned int Z_ramp_steps = 0;	// Z steps spent accelerating (steps needed to stop)
+
+	volatile unsigned char ramp_on = 0x00;	// Drives ramping, system_status running bits (only when driving to a known location)
+
+// S-curve (jerk limited) ramp.  Instead of adding *_accel each step the
+// speed follows scurve from *_min_speed to *_max_speed, so the
+// acceleration builds up and dies away smoothly at both ends of the
+// ramp.  Each table entry lasts *_scurve_steps half steps, the whole
+// ramp SCURVE_SIZE times that.  0 is the linear *_accel ramp.
+	const unsigned char scurve[SCURVE_SIZE] = {	// Speed, 256ths of max - min (3t^2 - 2t^3)
+		  0,   0,   1,   2,   3,   4,   6,   9,  11,  14,  17,  20,  24,  27,  31,  36,
+		 40,  45,  49,  54,  59,  65,  70,  75,  81,  87,  92,  98, 104, 110, 116, 122,
+		128, 134, 140, 146, 152, 158, 164, 169, 175, 181, 186, 191, 197, 202, 207, 211,
+		216, 220, 225, 229, 232, 236, 239, 242, 245, 247, 250, 252, 253, 254, 255, 255
+	};
+
+	volatile unsigned char X_scurve_steps = 0;	// X half steps per scurve entry (0 linear ramp)
+	volatile unsigned char Y_scurve_steps = 0;	// Y half steps per scurve entry (0 linear ramp)
+	volatile unsigned char Z_scurve_steps = 0;	// Z half steps per scurve entry (0 linear ramp)
+
+	volatile unsigned char X_curve_index = 0;	// X scurve entry running
+	volatile unsigned char Y_curve_index = 0;	// Y scurve entry running
+	volatile unsigned char Z_curve_index = 0;	// Z scurve entry running
+	volatile unsigned char X_curve_count = 0;	// X half steps made in the entry
+	volatile unsigned char Y_curve_count = 0;	// Y half steps made in the entry
+	volatile unsigned char Z_curve_count = 0;	// Z half steps made in the entry
+
+// This function returns speed on the S-curve at entry index of the
+// ramp from min to max.  span * scurve[] / 256 is done with shift and
+// add, a long multiply would take too long in the interrupt.  It is
+// only called from the interrupt routine (see X_SCURVE).
+unsigned int scurve_speed(unsigned int min, unsigned int max, unsigned char index)
+{
+	unsigned int span;		// max - min, shifted down
+	unsigned int add = 0;	// Speed over min
+	unsigned char fraction;
+
+	if(index >= SCURVE_SIZE || max <= min)
+		return max > min ? max : min;
+
+	span = max - min;
+	fraction = scurve[index];
+	for( unsigned char mask = 0x80; mask; mask >>= 1)
+	{
+		span >>= 1;
+		if(fraction & mask)
+			add += span;
+	}
+	return min + add;
+
+}	// End of scurve_speed function
+
+// This function, X_SCURVE is the S-curve ramp called by X_RAMP when
+// X_scurve_steps is set.  X_ramp_steps is counted the same way as the
+// linear ramp, so the deceleration starts at the same point and runs
+// back down the table.  steps is the half steps the last step made.
+void X_SCURVE(unsigned int to_go, unsigned char steps)
+{
+	unsigned char index = X_curve_index;
+
+	for( ; steps; steps--)
+	{
+		if(to_go <= X_ramp_steps)	// Decelerate, back down the table
+		{
+			if(!X_ramp_steps)
+				break;
+			X_ramp_steps--;
+			if(!X_curve_count)
+			{
+				X_curve_count = X_scurve_steps;
+				X_curve_index--;
+			}
+			X_curve_count--;
+		}
+		else if(X_curve_index < SCURVE_SIZE)	// Accelerate, up the table
+		{
+			X_ramp_steps++;
+			if(++X_curve_count >= X_scurve_steps)
+			{
+				X_curve_count = 0;
+				X_curve_index++;
+			}
+		}
+	}
+
+	if(index != X_curve_index)
+		X_speed = scurve_speed(X_min_speed, X_max_speed, X_curve_index);
+
+}	// End of X_SCURVE function
+
+// This function, Y_SCURVE is the S-curve ramp called by Y_RAMP.  See
+// X_SCURVE.
+void Y_SCURVE(unsigned int to_go, unsigned char steps)
+{
+	unsigned char index = Y_curve_index;
+
+	for( ; steps; steps--)
+	{
+		if(to_go <= Y_ramp_steps)	// Decelerate, back down the table
+		{
+			if(!Y_ramp_steps)
+				break;
+			Y_ramp_steps--;
+			if(!Y_curve_count)
+			{
+				Y_curve_count = Y_scurve_steps;
+				Y_curve_index--;
+			}
+			Y_curve_count--;
+		}
+		else if(Y_curve_index < SCURVE_SIZE)	// Accelerate, up the table
+		{
+			Y_ramp_steps++;
+			if(++Y_curve_count >= Y_scurve_steps)
+			{
+				Y_curve_count = 0;
+				Y_curve_index++;
+			}
+		}
+	}
+
+	if(index != Y_curve_index)
+		Y_speed = scurve_speed(Y_min_speed, Y_max_speed, Y_curve_index);
+
+}	// End of Y_SCURVE function
+
+// This function, Z_SCURVE is the S-curve ramp called by Z_RAMP.  See
+// X_SCURVE.
+void Z_SCURVE(unsigned int to_go, unsigned char steps)
+{
+	unsigned char index = Z_curve_index;
+
+	for( ; steps; steps--)
+	{
+		if(to_go <= Z_ramp_steps)	// Decelerate, back down the table
+		{
+			if(!Z_ramp_steps)
+				break;
+			Z_ramp_steps--;
+			if(!Z_curve_count)
+			{
+				Z_curve_count = Z_scurve_steps;
+				Z_curve_index--;
+			}
+			Z_curve_count--;
+		}
+		else if(Z_curve_index < SCURVE_SIZE)	// Accelerate, up the table
+		{
+			Z_ramp_steps++;
+			if(++Z_curve_count >= Z_scurve_steps)
+			{
+				Z_curve_count = 0;
+				Z_curve_index++;
+			}
+		}
+	}
+
+	if(index != Z_curve_index)
+		Z_speed = scurve_speed(Z_min_speed, Z_max_speed, Z_curve_index);
+
+}	// End of Z_SCURVE function
+
+// This function, X_RAMP is called by the X step interrupt (see main.c)
+// after every completed step.  The drive starts at X_min_speed (see
+// AXIS_START) and each step adds X_accel until X_max_speed is reached.
+// The number of steps spent accelerating is counted.  When the steps
+// left to X_new_location are down to that count the same ramp is run
+// in reverse so the drive arrives at X_new_location at X_min_speed.
+// A short move will simply turn around half way (triangle profile).
+// Speeds and steps are counted in half steps, a FULL step counts two
+// (see AXIS_FULL_TRAVERSE in drive_mode.c), and the drive goes back to
+// HALF step X_full_near half steps from X_new_location.  The step that
+// gets to X_new_location stops the drive here, the main loop may be
+// busy (see AXIS_DRIVE_DONE in drive_motor.c).
+void X_RAMP(void)
+{
+	unsigned short to_go;	// half steps left to X_new_location
+	unsigned int accel = X_accel;	// Speed change for the step made
+	unsigned char steps = 1;		// Half steps the step made
+
+	if(!RB2)	// FULL step, two half steps (see AXIS_FULL_TRAVERSE in drive_mode.c)
+	{
+		steps = 2;
+		accel <<= 1;
+	}
+
+	if(RB0)	// X DIR Clockwise
+	{
+		to_go = X_new_location - X_location;
+		if(X_new_location_hi - X_location_hi != (X_new_location < X_location))
+			to_go = 0xFFFF;	// Further than one move
+	}
+	else
+	{
+		to_go = X_location - X_new_location;
+		if(X_location_hi - X_new_location_hi != (X_location < X_new_location))
+			to_go = 0xFFFF;
+	}
+
+	if(!to_go)	// Arrived, stop at the step that got there
+	{
+		TMR2IE = 0; 	// No more X steps
+		TMR2ON = 0;
+		system_status &= 0b11101111; // X-Drive not running, AXIS_DRIVE_DONE finishes
+		return;
+	}
+
+	if(X_scurve_steps)	// S-curve (see X_SCURVE)
+		X_SCURVE(to_go, steps);
+	else if(to_go <= X_ramp_steps)	// Decelerate
+	{
+		if(X_ramp_steps > steps)
+			X_ramp_steps -= steps;
+		else
+			X_ramp_steps = 0;
+		if(X_speed > X_min_speed + accel)
+			X_speed -= accel;
+		else
+			X_speed = X_min_speed;
+	}
+	else if(X_speed < X_max_speed)	// Accelerate
+	{
+		X_ramp_steps += steps;
+		if(X_max_speed - X_speed > accel)
+			X_speed += accel;
+		else
+			X_speed = X_max_speed;
+	}
+
+	if(!RB2 && to_go <= X_full_near)
+		RB2 = 1; 	// HALF step the rest of the way (see drive_mode.c)
+
+	if(RB2)	// HALF step
+		PR2 = get_ramp_period(X_speed);	// Set Timer2 Period (see drive_timer.c)
+	else	// FULL step, same half step speed
+		PR2 = get_ramp_period(X_speed >> 1);
+	T2CON = ramp_tcon | 0b00000100;	// Set Timer2 pre-scale and post-scale (On)
+	if(X_vref_pwm)
+		X_RAMP_VREF_PWM();	// Keep the X reference level (see vref.c)
+
+}	// End of X_RAMP function
+
+// This function, Y_RAMP is called by the Y step interrupt (see main.c)
+// after every completed step.  See X_RAMP.
+void Y_RAMP(void)
+{
+	unsigned short to_go;	// half steps left to Y_new_location
+	unsigned int accel = Y_accel;	// Speed change for the step made
+	unsigned char steps = 1;		// Half steps the step made
+
+	if(!RA6)	// FULL step, two half steps (see AXIS_FULL_TRAVERSE in drive_mode.c)
+	{
+		steps = 2;
+		accel <<= 1;
+	}
+
+	if(RA4)	// Y DIR Clockwise
+	{
+		to_go = Y_new_location - Y_location;
+		if(Y_new_location_hi - Y_location_hi != (Y_new_location < Y_location))
+			to_go = 0xFFFF;	// Further than one move
+	}
+	else
+	{
+		to_go = Y_location - Y_new_location;
+		if(Y_location_hi - Y_new_location_hi != (Y_location < Y_new_location))
+			to_go = 0xFFFF;
+	}
+
+	if(!to_go)	// Arrived, stop at the step that got there
+	{
+		TMR4IE = 0; 	// No more Y steps
+		TMR4ON = 0;
+		system_status &= 0b11011111; // Y-Drive not running, AXIS_DRIVE_DONE finishes
+		return;
+	}
+
+	if(Y_scurve_steps)	// S-curve (see Y_SCURVE)
+		Y_SCURVE(to_go, steps);
+	else if(to_go <= Y_ramp_steps)	// Decelerate
+	{
+		if(Y_ramp_steps > steps)
+			Y_ramp_steps -= steps;
+		else
+			Y_ramp_steps = 0;
+		if(Y_speed > Y_min_speed + accel)
+			Y_speed -= accel;
+		else
+			Y_speed = Y_min_speed;
+	}
+	else if(Y_speed < Y_max_speed)	// Accelerate
+	{
+		Y_ramp_steps += steps;
+		if(Y_max_speed - Y_speed > accel)
+			Y_speed += accel;
+		else
+			Y_speed = Y_max_speed;
+	}
+
+	if(!RA6 && to_go <= Y_full_near)
+		RA6 = 1; 	// HALF step the rest of the way (see drive_mode.c)
+
+	if(RA6)	// HALF step
+		PR4 = get_ramp_period(Y_speed);	// Set Timer4 Period (see drive_timer.c)
+	else	// FULL step, same half step speed
+		PR4 = get_ramp_period(Y_speed >> 1);
+	T4CON = ramp_tcon | 0b00000100;	// Set Timer4 pre-scale and post-scale (On)
+
+}	// End of Y_RAMP function
+
+// This function, Z_RAMP is called by the Z step interrupt (see main.c)
+// after every completed step.  See X_RAMP.
+void Z_RAMP(void)
+{
+	unsigned short to_go;	// half steps left to Z_new_location
+	unsigned int accel = Z_accel;	// Speed change for the step made
+	unsigned char steps = 1;		// Half steps the step made
+
+	if(!RB6)	// FULL step, two half steps (see AXIS_FULL_TRAVERSE in drive_mode.c)
+	{
+		steps = 2;
+		accel <<= 1;
+	}
+
+	if(RB4)	// Z DIR Clockwise
+	{
+		to_go = Z_new_location - Z_location;
+		if(Z_new_location_hi - Z_location_hi != (Z_new_location < Z_location))
+			to_go = 0xFFFF;	// Further than one move
+	}
+	else
+	{
+		to_go = Z_location - Z_new_location;
+		if(Z_location_hi - Z_new_location_hi != (Z_location < Z_new_location))
+			to_go = 0xFFFF;
+	}
+
+	if(!to_go)	// Arrived, stop at the step that got there
+	{
+		TMR6IE = 0; 	// No more Z steps
+		TMR6ON = 0;
+		if(Z_pwm_on)
+			CCP3CON = 0x00;	// STEP back to RB5 (low, see drive_pwm.c)
+		system_status &= 0b10111111; // Z-Drive not running, AXIS_DRIVE_DONE finishes
+		return;
+	}
+
+	if(Z_scurve_steps)	// S-curve (see Z_SCURVE)
+		Z_SCURVE(to_go, steps);
+	else if(to_go <= Z_ramp_steps)	// Decelerate
+	{
+		if(Z_ramp_steps > steps)
+			Z_ramp_steps -= steps;
+		else
+			Z_ramp_steps = 0;
+		if(Z_speed > Z_min_speed + accel)
+			Z_speed -= accel;
+		else
+			Z_speed = Z_min_speed;
+	}
+	else if(Z_speed < Z_max_speed)	// Accelerate
+	{
+		Z_ramp_steps += steps;
+		if(Z_max_speed - Z_speed > accel)
+			Z_speed += accel;
+		else
+			Z_speed = Z_max_speed;
+	}
+
+	if(!RB6 && to_go <= Z_full_near)
+		RB6 = 1; 	// HALF step the rest of the way (see drive_mode.c)
+
+	if(Z_pwm_on)
+	{
+		PR6 = get_ramp_pwm_period(Z_speed);	// Set Timer6 Period (see drive_pwm.c)
+		CCPR3L = (PR6 >> 1) + 1;			// 50% duty from the next step
+	}
+	else if(RB6)	// HALF step
+		PR6 = get_ramp_period(Z_speed);	// Set Timer6 Period (see drive_timer.c)
+	else	// FULL step, same half step speed
+		PR6 = get_ramp_period(Z_speed >> 1);
+	T6CON = ramp_tcon | 0b00000100;	// Set Timer6 pre-scale and post-scale (On)
+
+}	// End of Z_RAMP function
+
+// The following is the serial interface access to set a drive's
+// acceleration.  The format is:
+//	[0] [1] [2] 'WAX', 'WAY' or 'WAZ' - Write acceleration
+//  [3] accel MSB (Hz per step)
+//  [4] accel LSB
+void write_accel(const axis_t *axis)
+{
+	*axis->accel = rx_arg;
+}	// End of write_accel function
+
+// The following is the serial interface access to set a drive's
+// ramp profile.  The format is:
+//	[0] [1] [2] 'WCX', 'WCY' or 'WCZ' - Write S-Curve
+//  [3] scurve_steps, half steps per scurve entry (0 linear accel ramp)
+void write_scurve(const axis_t *axis)
+{
+	*axis->scurve_steps = rx_arg;
+}	// End of write_scurve function
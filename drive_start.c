@@ -1,136 +1,212 @@
-/*
- * drive_start.c
- *
- * Sets up Timer and drive for Stepper Channels.
+/*
+ * drive_start.c
+ *
+ * Sets up Timer and drive for Stepper Channels.
  * 
-*/
-
-#include <pic.h>
-#include "globals.h";
-
-	volatile unsigned int X_location = 0;  	// this is the X axis current location from X_Home
-	volatile unsigned int Y_location = 0;  	// this is the Y axis current location from Y_Home
-	volatile unsigned int Z_location = 0;  	// this is the Z axis current location from Z_Home
-
-// This function, X_START sets up the timers and enables the
-// drive for the X stepper channel.
-void X_START(void)
-{
-	X_HALF_STEP();	// X HALF STEP MODE (default drive mode: see drive_mode.c)
-	PR2 = get_period(X_min_speed); // Set Timer2 Period
-	
-	// Set L297 vref if needed
-	if( working_vref != X_vref)
-	{
-		working_vref = X_vref;	// update working_vref for X drive (see vref.c)
-		SET_VREF();				// write X vref HW (see vref.c)
-	}	
-			
-	if((system_status & 0x08) != 0x08)
-	{
-		system_status |= 0x10;  // X-Drive running
-		RA0 = 1;   	// Enable RESET Line
-		msDelay(10);// Delay for RESET/Enable
-		TMR2IF = 0; // Clear Interrupt Flag
-		TMR2IE = 1; // TMR2 to PR2 Match Interrupt Enable bit
-		TMR2ON = 1; // Turn Timer On
-		RB1 = 1;	// Turn Step On
-	}	
-
-}	// End of X_START function
-
-// This function, Y_START sets up the timers and enables the
-// drive for the Y stepper channel.
-void Y_START(void)
-{
-	Y_HALF_STEP();	// Y HALF STEP MODE (default drive mode: see drive_mode.c)
-	PR4 = get_period(Y_min_speed); // Set Timer4 Period
-
-	// Set L297 vref if needed
-	if( working_vref != Y_vref)
-	{
-		working_vref = Y_vref;	// update working_vref for Y drive (see vref.c)
-		SET_VREF();				// write Y vref HW (see vref.c)
-	}	
-			
-	if((system_status & 0x08) != 0x08)
-	{
-		system_status |= 0x20;  // Y-Drive running
-		RA1 = 1;	// Enable RESET Line
-		msDelay(10);// Delay for RESET/Enable
-		TMR4IF = 0; // Clear Interrupt Flag
-		TMR4IE = 1; // TMR4 to PR4 Match Interrupt Enable bit
-		TMR4ON = 1; // Turn Timer On
-		RA5 = 1;	// Turn Step On
-	}	
-
-}	// End of Y_START function
-
-// This function, Z_START sets up the timers and enables the
-// drive for the Z stepper channel.
-void Z_START(void)
-{
-	Z_HALF_STEP();	// Z HALF STEP MODE (default drive mode: see drive_mode.c)
-	PR6 = get_period(Z_min_speed); // Set Timer6 Period
-	
-	// Set L297 vref if needed
-	if( working_vref != Z_vref)
-	{
-		working_vref = Z_vref;	// update working_vref for Z drive (see vref.c)
-		SET_VREF();				// write Z vref HW (see vref.c)
-	}	
-			
-	if((system_status & 0x08) != 0x08)
-	{
-		system_status |= 0x40;  // Z-Drive running
-		RA3 = 1;	// Enable RESET Line
-		msDelay(10);// Delay for RESET/Enable
-		TMR6IF = 0; // Clear Interrupt Flag
-		TMR6IE = 1; // TMR6 to PR6 Match Interrupt Enable bit
-		TMR6ON = 1; // Turn Timer On
-		RB5 = 1;	// Turn Step On
-	}	
-
-}	// End of Z_START function
-
-//  This is the serial interface access to read the current X location
-//  with respect to HOME
-void read_X_position(void)
-{
-	txfifo[0] = 2;				// Returning 2 chars
-	txfifo[1] = (unsigned char)(X_location >> 8 & 0xff);// X_location MSB
-	txfifo[2] = (unsigned char)(X_location & 0xff); 	// X_location LSB
-}	// End of read_X_location function
-
-//  This is the serial interface access to read the current Y location
-//  with respect to HOME
-void read_Y_position(void)
-{
-	txfifo[0] = 2;				// Returning 2 chars
-	txfifo[1] = (unsigned char)(Y_location >> 8 & 0xff);// Y_location MSB
-	txfifo[2] = (unsigned char)(Y_location & 0xff); 	// Y_location LSB
-}	// End of read_Y_location function
-
-//  This is the serial interface access to read the current Z location
-//  with respect to HOME
-void read_Z_position(void)
-{
-	txfifo[0] = 2;				// Returning 2 chars
-	txfifo[1] = (unsigned char)(Z_location >> 8 & 0xff);// Z_location MSB
-	txfifo[2] = (unsigned char)(Z_location & 0xff); 	// Z_location LSB
-}	// End of read_Z_location function
-
-void write_X_position(void)
-{
-	X_location	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_X_position function	
-
-void write_Y_position(void)
-{
-	Y_location	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_Y_position function	
-
-void write_Z_position(void)
-{
-	Z_location	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_Z_position function		
\ No newline at end of file
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+	volatile unsigned short X_location = 0;  	// this is the X axis current location from X_Home
+	volatile unsigned short Y_location = 0;  	// this is the Y axis current location from Y_Home
+	volatile unsigned short Z_location = 0;  	// this is the Z axis current location from Z_Home
+
+// The locations are signed 32 bit, in two words.  The step interrupts
+// only count the low word (X_location etc.) as before and carry into
+// the high word when it rolls over, which a step away from 0x0000 or
+// 0xFFFF only costs a test of the MSB.  Everything that only looks at
+// the distance to go of one move (ramps, FULL step, XYZ) keeps using
+// the low words, a move is up to 0xFFFF half steps (see AXIS_DRIVE in
+// drive_motor.c).  Past HOME is now negative instead of 0xFFFF.  The
+// words are short so the host build (32 bit int, see host/pic.h) rolls
+// them over, and carries, as the PIC does.
+	volatile short X_location_hi = 0;	// High word of the X location
+	volatile short Y_location_hi = 0;	// High word of the Y location
+	volatile short Z_location_hi = 0;	// High word of the Z location
+
+// The step interrupts change the locations while main() reads them a
+// byte at a time, so a step in between would give half of the old value
+// and half of the new one.  location_seq goes up every time the isr
+// changes a location or a hit location (see X_LIMIT in system_status.c)
+// and main() reads them with LOCATION, which reads again if it changed.
+// No interrupts are turned off and the isr only pays for one increment.
+	volatile unsigned char location_seq = 0;	// Bumped by the isr with every location change
+
+	volatile unsigned char drive_starting = 0x00;	// Drives waiting to start (system_status bits)
+	volatile unsigned char drive_reset_ms = 0;		// mSec left of the RESET/Enable delay
+
+// This function, AXIS_START sets up the timer and enables the
+// drive for the stepper channel of axis at speed (step frequency).
+void AXIS_START(const axis_t *axis, unsigned int speed)
+{
+	AXIS_HALF_STEP(axis);	// HALF STEP MODE (default drive mode: see drive_mode.c)
+	if(axis->name == 'Z' && Z_step_pwm)
+		Z_PWM_START(speed);	// STEP from CCP3, HALF step only (see drive_pwm.c)
+	else
+	{
+		if((ramp_on & axis->running) && AXIS_FULL_TRAVERSE(axis))	// FULL step to near new_location
+			*axis->pr = get_period(speed >> 1); // Set Timer Period, same half step speed
+		else
+			*axis->pr = get_period(speed); // Set Timer Period
+		*axis->tcon = period_tcon; // Set Timer pre-scale and post-scale (Off)
+	}
+	*axis->speed = speed;	// Ramp starts here (see drive_ramp.c)
+	*axis->ramp_steps = 0;
+	*axis->curve_index = *axis->curve_count = 0;	// S-curve starts at the bottom too
+	
+	// Set L297 vref if needed
+	if(axis->name == 'X' && X_vref_pwm)
+		X_VREF_PWM_START();	// X has its own reference (see vref.c)
+	else if( !vref_locked && working_vref != *axis->vref)
+	{
+		working_vref = *axis->vref;	// update working_vref for the drive (see vref.c)
+		SET_VREF(*axis->vref_settle);	// write vref HW (see vref.c)
+	}	
+			
+	if((system_status & 0x08) != 0x08)
+	{
+		GIE = 0;	// The step interrupts write these too
+		system_status |= axis->running;  // Drive running
+		PORTA |= axis->reset;   	// Enable RESET Line
+		limit_hit &= ~axis->limits;	// No hit yet (see X_LIMIT in system_status.c)
+		drive_reset_ms = DRIVE_RESET_MS;	// Delay for RESET/Enable
+		drive_starting |= axis->running;	// Started by DRIVE_GO (see isr)
+		GIE = 1;
+	}	
+
+}	// End of AXIS_START function
+
+// This function, DRIVE_GO is called by the Timer0 tick (see isr in
+// main.c) while drives are waiting to start.  AXIS_START and XYZ_DRIVE set
+// up the drive, enable its RESET line and return, so the RESET/Enable
+// delay, a Vref settle (see SET_VREF in vref.c) and the commands that
+// follow all run at the same time.  Each mSec the drives are held only
+// by Vref is counted in vref_wait_ms.  Once both are over the timers
+// and STEP lines are turned on.
+void DRIVE_GO(void)
+{
+	if(drive_reset_ms)
+	{
+		drive_reset_ms--;
+		return;
+	}
+
+	if(!vref_ready)
+	{
+		vref_wait_ms++;	// Held by Vref only
+		return;
+	}
+
+	// Not into a switch that is already made (see X_LIMIT in
+	// system_status.c), XYZ_STEP checks its own
+	if((drive_starting & 0x10) && (xyz_mode || !X_LIMIT()))
+	{
+		TMR2IF = 0; // Clear Interrupt Flag
+		TMR2IE = 1; // TMR2 to PR2 Match Interrupt Enable bit
+		TMR2ON = 1; // Turn Timer On
+		if(!xyz_mode)
+			RB1 = 1;	// Turn Step On (XYZ_STEP drives its own)
+	}
+
+	if((drive_starting & 0x20) && !Y_LIMIT())
+	{
+		TMR4IF = 0; // Clear Interrupt Flag
+		TMR4IE = 1; // TMR4 to PR4 Match Interrupt Enable bit
+		TMR4ON = 1; // Turn Timer On
+		RA5 = 1;	// Turn Step On
+	}
+
+	if((drive_starting & 0x40) && !Z_LIMIT())
+	{
+		TMR6IF = 0; // Clear Interrupt Flag
+		TMR6IE = 1; // TMR6 to PR6 Match Interrupt Enable bit
+		TMR6ON = 1; // Turn Timer On
+		if(Z_step_pwm)
+		{
+			Z_pwm_on = 1;			// One interrupt per step (see isr in main.c)
+			CCP3CON = 0b00001100;	// CCP3 PWM mode, STEP from the next period on
+		}
+		else
+			RB5 = 1;	// Turn Step On
+	}
+
+	drive_starting = 0x00;
+
+}	// End of DRIVE_GO function
+
+// This function, POSITION puts the two words of a location back
+// together as one signed 32 bit value.
+long POSITION(short hi, unsigned short lo)
+{
+	return ((long)hi << 16) | lo;
+
+}	// End of POSITION function
+
+// This function, LOCATION returns a location the step interrupts change
+// (see location_seq above), both words from the same step.
+long LOCATION(volatile unsigned short *location, volatile short *location_hi)
+{
+	unsigned char seq;
+	unsigned short at;
+	short at_hi;
+
+	do
+	{
+		seq = location_seq;
+		at = *location;
+		at_hi = *location_hi;
+	} while(seq != location_seq);	// A step came in, again
+	return POSITION(at_hi, at);
+
+}	// End of LOCATION function
+
+// This sends a signed 32 bit location as 4 chars of a reply frame,
+// MSB first (see SendByte in ser.c).
+void tx_location(long at)
+{
+	SendByte((unsigned char)(at >> 24));
+	SendByte((unsigned char)(at >> 16));
+	SendByte((unsigned char)(at >> 8));
+	SendByte((unsigned char)(at & 0xff));
+}	// End of tx_location function
+
+//  This is the serial interface access to read the current location
+//  of an axis with respect to HOME ('RPX', 'RPY' or 'RPZ'), the low
+//  word, MSB first
+void read_position(const axis_t *axis)
+{
+	unsigned int at = (unsigned int)LOCATION(axis->location, axis->location_hi);	// Low word
+
+	SendStart(2);				// Returning 2 chars
+	SendByte((unsigned char)(at >> 8 & 0xff));	// location MSB
+	SendByte((unsigned char)(at & 0xff)); 		// location LSB
+	SendEnd();
+}	// End of read_position function
+
+//  This is the serial interface access to read the current location
+//  with respect to HOME, all 32 bits: 'REX', 'REY' or 'REZ' returns 4
+//  chars, MSB first
+void read_position_long(const axis_t *axis)
+{
+	SendStart(4);				// Returning 4 chars
+	tx_location(LOCATION(axis->location, axis->location_hi));
+	SendEnd();
+}	// End of read_position_long function
+
+//  This is the serial interface to set the location.  The format is:
+//	[0] [1] [2] 'WPX', 'WPY' or 'WPZ'
+//  [3] [4] 0 to 0xFFFF, or [3] to [6] signed 32 bit, MSB first
+void write_position(const axis_t *axis)
+{
+	long at = RX_LOCATION(0);
+
+	*axis->location	= (unsigned int)at;
+	*axis->location_hi = (int)(at >> 16);
+
+	if(!(system_status & axis->running))	// The queue counts from here (see MOTION_END)
+	{
+		*axis->new_location = (unsigned int)at;
+		*axis->new_location_hi = (int)(at >> 16);
+	}
+}	// End of write_position function		
\ No newline at end of file
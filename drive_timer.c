@@ -1,121 +1,202 @@
-/*
- * drive_timer.c
- *
- * Sets stepper drive timers.
+/*
+ * drive_timer.c
+ *
+ * Sets stepper drive timers.
  * 
-*/
-
-#include <pic.h>
-#include "globals.h";
-
-	volatile unsigned int X_max_speed = 2000;  	// this will X axis max step frequency (for ramp)
-	volatile unsigned int Y_max_speed = 2000;  	// this will Y axis max step frequency (for ramp)
-	volatile unsigned int Z_max_speed = 1000;  	// this will Z axis max step frequency (for ramp)
-	
-	volatile unsigned int X_min_speed = 1300;  	// this will X axis min step frequency
-	volatile unsigned int Y_min_speed = 750;  	// this will Y axis min step frequency
-	volatile unsigned int Z_min_speed = 500;  	// this will Z axis min step frequency
-
-// This function will set the stepper timers up.  The resolution
-// of these timers will be 8 uSec. (32M FOSC/4) / 64(post scale)
-// This allows for a range from 125000 to about 490 Hz without 
-// having to adjust the timers.  The drive pulse will be half the
-// width of the stepper frequency.  The interrupt routines will
-// toggle the drive (High/Low) based on the timer matching the
-// period.
-void SET_TIMERS(void)
-{
-	TMR2 = 0x00;	// Clear X drive Timer
-	TMR4 = 0x00;	// Clear Y drive Timer
-	TMR6 = 0x00;	// Clear Z drive Timer
-	
-	T2CON = 0b00000011; // X drive, 1:1 pre-scale, 1:64 post, Off
-	T4CON = 0b00000011; // Y drive, 1:1 pre-scale, 1:64 post, Off
-	T6CON = 0b00000011; // Z drive, 1:1 pre-scale, 1:64 post, Off
-	
-}	// End of SET_TIMERS function
-
-// This function will calculate the timer period for the interrupt 
-// match (PR2 - X, PR4 - Y, PR6 - Z).  The timer will count to this
-// value.  When a match occurs an interrupt is issued.  The period
-// setting will be 1/2 the frequency width so the signal will be on
-// half the cycle and off the other half.  One cycle equals two period
-// interrupts.  The max speed is limited by the unsigned speed value
-// of 0xFFF.  The min is rounded up from ~245.09 which is 0xFF.
-unsigned char get_period(unsigned int speed)
-{
-	if((speed <= 65535.0) && (speed >= 246.0))// This could be faster then 65kHz
-	{
-		system_status &= 0b11110111;	// clear Period error status
-		return (unsigned char)((125000/(speed * 2.0)));
-	}
-	else
-	{
-		system_status |= 0b00001001;	// set Period error status
-		return 0xFF;
-	}
-	
-}	// End of get_period function
-
-// The following is the serial interface access to sets the max frequency 
-// to run the X-Drive
-void write_X_fast(void)
-{
-	X_max_speed	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_X_fast function		
-
-// The following is the serial interface access to sets the max frequency 
-// to run the Y-Drive
-void write_Y_fast(void)
-{
-	Y_max_speed	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_Y_fast function
-
-// The following is the serial interface access to sets the max frequency 
-// to run the Z-Drive
-void write_Z_fast(void)
-{
-	Z_max_speed	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_Z_fast function	
-
-// The following is the serial interface access to sets the lowest frequency 
-// to run the X-Drive
-void write_X_slow(void)
-{
-	X_min_speed	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_X_slow function	
-
-// The following is the serial interface access to sets the lowest frequency 
-// to run the Y-Drive
-void write_Y_slow(void)
-{
-	Y_min_speed	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_Y_slow function	
-
-// The following is the serial interface access to sets the lowest frequency 
-// to run the Z-Drive
-void write_Z_slow(void)
-{
-	Z_min_speed	= (unsigned int)((rxfifo[3] << 8) | rxfifo[4]);
-}	// End of write_X_slow function		
-
-
-// Set up delay for settle.  Use interrupt so RX commands can still be captured
-void msDelay(unsigned int msTime)
-{
-	TMR0 = 0x06;  		// This is the gbl_ms_Timer (Timer 0)
-	TMR0IF = 0;			// Clear Timer Flag
-	TMR0IE = 1;			// Timer Interrupt Enable
-	gbl_ms_Timer = 0; 	// Reset this timer
-	ms_Timer_flag = 1;	// Enable FW Flag
-		
-	// Poll Timer
-	while((gbl_ms_Timer < msTime) && ms_Timer_flag)
-	{
-		/* do nothing but wait. Allow for interrupts. */
-	}	
-
-	ms_Timer_flag = 0;	// Disable FW Flag
-	TMR0IE = 0;			// Disable Interrupt		
-}	// End of msDelay
-		
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+	volatile unsigned int X_max_speed = 2000;  	// this will X axis max step frequency (for ramp)
+	volatile unsigned int Y_max_speed = 2000;  	// this will Y axis max step frequency (for ramp)
+	volatile unsigned int Z_max_speed = 1000;  	// this will Z axis max step frequency (for ramp)
+	
+	volatile unsigned int X_min_speed = 1300;  	// this will X axis min step frequency
+	volatile unsigned int Y_min_speed = 750;  	// this will Y axis min step frequency
+	volatile unsigned int Z_min_speed = 500;  	// this will Z axis min step frequency
+
+	volatile unsigned char period_tcon = 0b00000011;	// T2CON/T4CON/T6CON scale from get_period
+	volatile unsigned char ramp_tcon = 0b00000011;		// T2CON/T4CON/T6CON scale from get_ramp_period
+
+// This function will set the stepper timers up.  The timers count
+// instruction cycles (32M FOSC/4 = 125 nSec) through a pre-scaler
+// and interrupt through a post-scaler.  Both scalers are picked for
+// each speed together with the period (see get_period) so this only
+// sets them to a safe start.  The drive pulse will be half the
+// width of the stepper frequency.  The interrupt routines will
+// toggle the drive (High/Low) based on the timer matching the
+// period.
+void SET_TIMERS(void)
+{
+	TMR2 = 0x00;	// Clear X drive Timer
+	TMR4 = 0x00;	// Clear Y drive Timer
+	TMR6 = 0x00;	// Clear Z drive Timer
+	
+	T2CON = 0b00000011; // X drive, 1:64 pre-scale, 1:1 post, Off
+	T4CON = 0b00000011; // Y drive, 1:64 pre-scale, 1:1 post, Off
+	T6CON = 0b00000011; // Z drive, 1:64 pre-scale, 1:1 post, Off
+	
+}	// End of SET_TIMERS function
+
+// The timers can count through a total scale (pre-scale * post-scale)
+// of any power of 2 from 1 to 1024.  This table is the TxCON value
+// (post-scale T2OUTPS<3:0> in bits 6:3, pre-scale T2CKPS<1:0> in bits
+// 1:0, timer off) for each power.
+	const unsigned char scale_tcon[11] = {
+		0b00000000,	// 1:1		pre 1:1,  post 1:1
+		0b00001000,	// 1:2		pre 1:1,  post 1:2
+		0b00000001,	// 1:4		pre 1:4,  post 1:1
+		0b00001001,	// 1:8		pre 1:4,  post 1:2
+		0b00000010,	// 1:16		pre 1:16, post 1:1
+		0b00001010,	// 1:32		pre 1:16, post 1:2
+		0b00000011,	// 1:64		pre 1:64, post 1:1
+		0b00001011,	// 1:128	pre 1:64, post 1:2
+		0b00011011,	// 1:256	pre 1:64, post 1:4
+		0b00111011,	// 1:512	pre 1:64, post 1:8
+		0b01111011	// 1:1024	pre 1:64, post 1:16
+	};
+
+// Half a step at a speed is 4000000/speed instruction cycles.  The
+// smallest total scale is picked that brings this down to 255 counts
+// or less, so the period (PR + 1) is always 128 to 255 counts and the
+// speed is never off by more than 1/128 (0.8%).  Put the other way
+// around, speed * scale ends up between 15626 and 31250.  This table
+// is the fastest scaled speed for each count, period_speed[n - 128] =
+// 4000000/n, so a scaled speed gets n counts when period_speed[n - 127]
+// < scaled speed <= period_speed[n - 128].  It is held in flash (256
+// bytes) so the counts are found by a binary search of 7 compares
+// instead of a division.
+	const unsigned int period_speed[128] = {
+		31250, 31007, 30769, 30534, 30303, 30075, 29850, 29629,	// 128 - 135
+		29411, 29197, 28985, 28776, 28571, 28368, 28169, 27972,	// 136 - 143
+		27777, 27586, 27397, 27210, 27027, 26845, 26666, 26490,	// 144 - 151
+		26315, 26143, 25974, 25806, 25641, 25477, 25316, 25157,	// 152 - 159
+		25000, 24844, 24691, 24539, 24390, 24242, 24096, 23952,	// 160 - 167
+		23809, 23668, 23529, 23391, 23255, 23121, 22988, 22857,	// 168 - 175
+		22727, 22598, 22471, 22346, 22222, 22099, 21978, 21857,	// 176 - 183
+		21739, 21621, 21505, 21390, 21276, 21164, 21052, 20942,	// 184 - 191
+		20833, 20725, 20618, 20512, 20408, 20304, 20202, 20100,	// 192 - 199
+		20000, 19900, 19801, 19704, 19607, 19512, 19417, 19323,	// 200 - 207
+		19230, 19138, 19047, 18957, 18867, 18779, 18691, 18604,	// 208 - 215
+		18518, 18433, 18348, 18264, 18181, 18099, 18018, 17937,	// 216 - 223
+		17857, 17777, 17699, 17621, 17543, 17467, 17391, 17316,	// 224 - 231
+		17241, 17167, 17094, 17021, 16949, 16877, 16806, 16736,	// 232 - 239
+		16666, 16597, 16528, 16460, 16393, 16326, 16260, 16194,	// 240 - 247
+		16129, 16064, 16000, 15936, 15873, 15810, 15748, 15686	// 248 - 255
+	};
+
+// This function will calculate the timer period for the interrupt 
+// match (PR2 - X, PR4 - Y, PR6 - Z).  The timer will count to this
+// value.  When a match occurs an interrupt is issued.  The period
+// setting will be 1/2 the frequency width so the signal will be on
+// half the cycle and off the other half.  One cycle equals two period
+// interrupts.  The pre-scale and post-scale that go with the period
+// are left in period_tcon for TxCON.  The speed can be MIN_STEP_SPEED
+// (16 Hz, the largest scale and period) to MAX_STEP_SPEED (31250 Hz,
+// 16 uSec between interrupts).
+unsigned char get_period(unsigned int speed)
+{
+	unsigned char scale = 0;	// Power of 2 of the total scale
+	unsigned char count = 0;	// Counts - 128
+
+	if((speed <= MAX_STEP_SPEED) && (speed >= MIN_STEP_SPEED))
+	{
+		system_status &= 0b11110111;	// clear Period error status
+
+		// Smallest scale that gets speed * scale over 15625 (see
+		// get_ramp_period, the isr has its own copy of this)
+		while(speed <= 15625)
+		{
+			speed <<= 1;
+			scale++;
+		}
+
+		// Most counts with period_speed[count] >= scaled speed
+		for( unsigned char mask = 0x40; mask; mask >>= 1)
+			if(period_speed[count | mask] >= speed)
+				count |= mask;
+
+		period_tcon = scale_tcon[scale];
+		return count + 127;	// PR = counts - 1
+	}
+	else
+	{
+		system_status |= 0b00001001;	// set Period error status
+		period_tcon = scale_tcon[10];
+		return 0xFF;
+	}
+	
+}	// End of get_period function
+
+// This function is the same calculation as get_period but is used
+// by the ramp (see drive_ramp.c) from the interrupt routine.  The
+// scale is left in ramp_tcon.  It does not touch system_status.  The
+// ramp speeds lie between speeds already checked by get_period when
+// the drive was started.
+unsigned char get_ramp_period(unsigned int speed)
+{
+	unsigned char scale = 0;	// Power of 2 of the total scale
+	unsigned char count = 0;	// Counts - 128
+
+	if(speed < MIN_STEP_SPEED)
+		speed = MIN_STEP_SPEED;	// Slowest period
+	else if(speed > MAX_STEP_SPEED)
+		speed = MAX_STEP_SPEED;	// Fastest period
+
+	while(speed <= 15625)
+	{
+		speed <<= 1;
+		scale++;
+	}
+
+	for( unsigned char mask = 0x40; mask; mask >>= 1)
+		if(period_speed[count | mask] >= speed)
+			count |= mask;
+
+	ramp_tcon = scale_tcon[scale];
+	return count + 127;	// PR = counts - 1
+
+}	// End of get_ramp_period function
+
+// The following is the serial interface access to sets the max frequency 
+// to run a drive.  The format is:
+//	[0] [1] [2] 'WFX', 'WFY' or 'WFZ' - Write Fast
+//  [3] max_speed MSB (Hz)
+//  [4] max_speed LSB
+void write_fast(const axis_t *axis)
+{
+	*axis->max_speed = rx_arg;
+}	// End of write_fast function		
+
+// The following is the serial interface access to sets the lowest frequency 
+// to run a drive.  The format is:
+//	[0] [1] [2] 'WSX', 'WSY' or 'WSZ' - Write Slow
+//  [3] min_speed MSB (Hz)
+//  [4] min_speed LSB
+void write_slow(const axis_t *axis)
+{
+	*axis->min_speed = rx_arg;
+}	// End of write_slow function	
+
+
+// Set up delay for settle.  Use interrupt so RX commands can still be captured.
+// The Timer0 interrupt is always enabled (it also times out RX frames, see
+// main.c) so it is left on here.
+void msDelay(unsigned int msTime)
+{
+	TMR0 = 0x06;  		// This is the gbl_ms_Timer (Timer 0)
+	TMR0IF = 0;			// Clear Timer Flag
+	gbl_ms_Timer = 0; 	// Reset this timer
+	ms_Timer_flag = 1;	// Enable FW Flag
+		
+	// Poll Timer
+	while((gbl_ms_Timer < msTime) && ms_Timer_flag)
+	{
+		/* do nothing but wait. Allow for interrupts. */
+		HAL_IDLE();
+	}	
+
+	ms_Timer_flag = 0;	// Disable FW Flag
+}	// End of msDelay
+		
@@ -0,0 +1,373 @@
+/*
+ * drive_xyz.c
+ *
+ * Coordinated (linear interpolated) XYZ drive.  All three axes are
+ * stepped from the X drive timer (Timer2) so they start and finish
+ * together.
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+	volatile bit xyz_mode = 0;		// Timer2 is stepping XYZ together (see isr in main.c)
+	volatile bit xyz_step_high = 0;	// STEP lines were driven high on the last Timer2 match
+
+	volatile unsigned int xyz_to_go = 0;	// Steps left on the longest (major) axis
+	volatile unsigned int xyz_major = 0;	// Steps of the longest (major) axis
+	volatile unsigned char xyz_moving = 0;	// system_status running bits of the moving axes
+
+	volatile unsigned int X_delta = 0;	// X steps to travel
+	volatile unsigned int Y_delta = 0;	// Y steps to travel
+	volatile unsigned int Z_delta = 0;	// Z steps to travel
+
+// The error terms stay below xyz_major (up to 0xFFFF), XYZ_STEP tests
+// before adding so they never go past 16 bits.  They are short so the
+// host build (32 bit int, see host/pic.h) wraps them as the PIC would.
+	volatile unsigned short X_err = 0;	// X step distribution error term
+	volatile unsigned short Y_err = 0;	// Y step distribution error term
+	volatile unsigned short Z_err = 0;	// Z step distribution error term
+
+	volatile unsigned int xyz_min_speed = 0;	// Slowest min speed of the moving axes
+	volatile unsigned int xyz_max_speed = 0;	// Slowest max speed of the moving axes
+	volatile unsigned int xyz_accel = 0;		// Smallest acceleration of the moving axes
+	volatile unsigned int xyz_speed = 0;		// Major axis step frequency currently running
+	volatile unsigned int xyz_ramp_steps = 0;	// Major axis steps spent accelerating
+
+// This function, XYZ_LIMIT is called by XYZ_STEP before the STEP
+// lines are driven high (see X_LIMIT in system_status.c).  A switch
+// made ahead of any moving axis stops Timer2 and with it the whole
+// move.
+unsigned char XYZ_LIMIT(void)
+{
+	unsigned char ahead = 0x00;	// Switches in the direction of travel
+	unsigned char hit;
+
+	if(X_delta)
+		ahead |= RB0 ? 0x02 : 0x01;
+	if(Y_delta)
+		ahead |= RA4 ? 0x08 : 0x04;
+	if(Z_delta)
+		ahead |= RB4 ? 0x20 : 0x10;
+
+	hit = ~(PORTC) & ahead;
+	if(hit)
+	{
+		TMR2IE = 0; 	// No more XYZ steps
+		TMR2ON = 0;
+		if(hit & 0x03)
+			X_hit_location = POSITION(X_location_hi, X_location);
+		if(hit & 0x0C)
+			Y_hit_location = POSITION(Y_location_hi, Y_location);
+		if(hit & 0x30)
+			Z_hit_location = POSITION(Z_location_hi, Z_location);
+		location_seq++;
+		limit_hit |= hit;
+		limit_status |= hit;
+		system_status &= 0b10001111; // Drives not running, XYZ_DRIVE_DONE finishes
+	}
+	return hit;
+
+}	// End of XYZ_LIMIT function
+
+// This function, XYZ_STEP is called by the X step interrupt (see main.c)
+// when xyz_mode is set.  It is a Bresenham (DDA) step distribution:
+// every Timer2 match pair is one step of the longest axis and the other
+// axes add their delta to an error term, stepping when it rolls past
+// xyz_major.  The test is made before the add, X_err + X_delta can be
+// up to twice xyz_major and would not fit 16 bits.  The first match
+// drives the selected STEP lines high, the second drives them low and
+// updates the locations.
+void XYZ_STEP(void)
+{
+	if(!xyz_step_high)
+	{
+		if(XYZ_LIMIT())
+			return;	// Stopped at a switch, XYZ_DRIVE_DONE finishes
+
+		if(X_err >= xyz_major - X_delta)
+		{
+			X_err -= xyz_major - X_delta;
+			RB1 = 1;	// Drive X STEP High
+		}
+		else
+			X_err += X_delta;
+
+		if(Y_err >= xyz_major - Y_delta)
+		{
+			Y_err -= xyz_major - Y_delta;
+			RA5 = 1;	// Drive Y STEP High
+		}
+		else
+			Y_err += Y_delta;
+
+		if(Z_err >= xyz_major - Z_delta)
+		{
+			Z_err -= xyz_major - Z_delta;
+			RB5 = 1;	// Drive Z STEP High
+		}
+		else
+			Z_err += Z_delta;
+
+		xyz_step_high = 1;
+	}
+	else
+	{
+		if(RB1)	// X stepped
+		{
+			if(RB0)	// X DIR Clockwise
+			{
+				if(!++X_location)
+					X_location_hi++;	// Carry (see drive_start.c)
+			}
+			else if(!X_location--)
+				X_location_hi--;	// Borrow
+			RB1 = 0;	// Drive X STEP low
+		}
+
+		if(RA5)	// Y stepped
+		{
+			if(RA4)	// Y DIR Clockwise
+			{
+				if(!++Y_location)
+					Y_location_hi++;	// Carry (see drive_start.c)
+			}
+			else if(!Y_location--)
+				Y_location_hi--;	// Borrow
+			RA5 = 0;	// Drive Y STEP low
+		}
+
+		if(RB5)	// Z stepped
+		{
+			if(RB4)	// Z DIR Clockwise
+			{
+				if(!++Z_location)
+					Z_location_hi++;	// Carry (see drive_start.c)
+			}
+			else if(!Z_location--)
+				Z_location_hi--;	// Borrow
+			RB5 = 0;	// Drive Z STEP low
+		}
+
+		xyz_step_high = 0;
+		location_seq++;	// (see LOCATION in drive_start.c)
+
+		if(xyz_to_go)
+			xyz_to_go--;
+
+		if(xyz_to_go == 0)
+		{
+			TMR2ON = 0;	// Arrived, no more STEP edges until XYZ_DRIVE is done
+			return;
+		}
+
+		// Ramp the major axis (see X_RAMP in drive_ramp.c)
+		if(xyz_to_go <= xyz_ramp_steps)	// Decelerate
+		{
+			if(xyz_ramp_steps)
+				xyz_ramp_steps--;
+			if(xyz_speed > xyz_min_speed + xyz_accel)
+				xyz_speed -= xyz_accel;
+			else
+				xyz_speed = xyz_min_speed;
+		}
+		else if(xyz_speed < xyz_max_speed)	// Accelerate
+		{
+			xyz_ramp_steps++;
+			if(xyz_max_speed - xyz_speed > xyz_accel)
+				xyz_speed += xyz_accel;
+			else
+				xyz_speed = xyz_max_speed;
+		}
+
+		PR2 = get_ramp_period(xyz_speed);	// Set Timer2 Period (see drive_timer.c)
+		T2CON = ramp_tcon | 0b00000100;	// Set Timer2 pre-scale and post-scale (On)
+		if(X_vref_pwm && X_delta)
+			X_RAMP_VREF_PWM();	// Keep the X reference level (see vref.c)
+	}
+
+}	// End of XYZ_STEP function
+
+// This function, XYZ_DRIVE will drive all three axes to X_new_location,
+// Y_new_location and Z_new_location at the same time.  The speed limits
+// used are the most restrictive of the axes that move so none of them
+// run faster than its own settings.  The L297s share DACOUT so the
+// largest Vref of the moving axes is used, except X when it has its
+// own reference (see X_vref_pwm in vref.c).  A limit hit on any moving
+// axis stops the whole move.  The drive is only started here,
+// XYZ_DRIVE_DONE finishes the move.
+void XYZ_DRIVE(void)
+{
+	unsigned char vref = 0x00;		// Largest vref of the moving axes
+	unsigned int settle = 0;		// Its settle time (see vref.c)
+	long X_to_go, Y_to_go, Z_to_go;	// Signed half steps to the new locations
+
+	TRG_ABORT();	// Abort all XYZ movement (see abort.c)
+
+	X_to_go = POSITION(X_new_location_hi, X_new_location) - POSITION(X_location_hi, X_location);
+	Y_to_go = POSITION(Y_new_location_hi, Y_new_location) - POSITION(Y_location_hi, Y_location);
+	Z_to_go = POSITION(Z_new_location_hi, Z_new_location) - POSITION(Z_location_hi, Z_location);
+	if(X_to_go > 0xFFFF || X_to_go < -0xFFFF || Y_to_go > 0xFFFF || Y_to_go < -0xFFFF
+			|| Z_to_go > 0xFFFF || Z_to_go < -0xFFFF)
+	{
+		system_status |= 0x03; 	// Invalid command (too far for one move)
+								// Error
+		return;
+	}
+
+	xyz_moving = 0x00;
+	xyz_to_go = 0;
+	xyz_min_speed = 0xFFFF;
+	xyz_max_speed = 0xFFFF;
+	xyz_accel = 0xFFFF;
+
+	// Select drive direction and distance for each axis
+	if( X_to_go < 0)
+	{
+		RB0 = 0; // DIR = Counter clockwise
+		X_delta = (unsigned int)-X_to_go;
+	}
+	else
+	{
+		RB0 = 1; // DIR = clockwise
+		X_delta = (unsigned int)X_to_go;
+	}
+
+	if( Y_to_go < 0)
+	{
+		RA4 = 0; // DIR = Counter clockwise
+		Y_delta = (unsigned int)-Y_to_go;
+	}
+	else
+	{
+		RA4 = 1; // DIR = clockwise
+		Y_delta = (unsigned int)Y_to_go;
+	}
+
+	if( Z_to_go < 0)
+	{
+		RB4 = 0; // DIR = Counter clockwise
+		Z_delta = (unsigned int)-Z_to_go;
+	}
+	else
+	{
+		RB4 = 1; // DIR = clockwise
+		Z_delta = (unsigned int)Z_to_go;
+	}
+
+	// Pick up the settings of the axes that move
+	if(X_delta)
+	{
+		xyz_moving |= 0x10;
+		AXIS_HALF_STEP(&axes[AXIS_INDEX('X')]);	// (see drive_mode.c)
+		if(X_min_speed < xyz_min_speed) xyz_min_speed = X_min_speed;
+		if(X_max_speed < xyz_max_speed) xyz_max_speed = X_max_speed;
+		if(X_accel < xyz_accel) xyz_accel = X_accel;
+		if(!X_vref_pwm && X_vref > vref)	// X has its own reference (see vref.c)
+		{
+			vref = X_vref;
+			settle = X_vref_settle;
+		}
+	}
+
+	if(Y_delta)
+	{
+		xyz_moving |= 0x20;
+		AXIS_HALF_STEP(&axes[AXIS_INDEX('Y')]);	// (see drive_mode.c)
+		if(Y_min_speed < xyz_min_speed) xyz_min_speed = Y_min_speed;
+		if(Y_max_speed < xyz_max_speed) xyz_max_speed = Y_max_speed;
+		if(Y_accel < xyz_accel) xyz_accel = Y_accel;
+		if(Y_vref > vref)
+		{
+			vref = Y_vref;
+			settle = Y_vref_settle;
+		}
+	}
+
+	if(Z_delta)
+	{
+		xyz_moving |= 0x40;
+		AXIS_HALF_STEP(&axes[AXIS_INDEX('Z')]);	// (see drive_mode.c)
+		if(Z_min_speed < xyz_min_speed) xyz_min_speed = Z_min_speed;
+		if(Z_max_speed < xyz_max_speed) xyz_max_speed = Z_max_speed;
+		if(Z_accel < xyz_accel) xyz_accel = Z_accel;
+		if(Z_vref > vref)
+		{
+			vref = Z_vref;
+			settle = Z_vref_settle;
+		}
+	}
+
+	if(xyz_moving == 0x00)
+		return;	// Already there
+
+	// The longest axis sets the number of Timer2 steps
+	xyz_major = X_delta;
+	if(Y_delta > xyz_major) xyz_major = Y_delta;
+	if(Z_delta > xyz_major) xyz_major = Z_delta;
+
+	xyz_to_go = xyz_major;
+	X_err = Y_err = Z_err = xyz_major >> 1;	// Start half way to round the steps
+	xyz_speed = xyz_min_speed;
+	xyz_ramp_steps = 0;
+	xyz_step_high = 0;
+
+	PR2 = get_period(xyz_min_speed); // Set Timer2 Period
+	T2CON = period_tcon; // Set Timer2 pre-scale and post-scale (Off)
+
+	// Set L297 vref if needed
+	if(X_vref_pwm && X_delta)
+		X_VREF_PWM_START();		// X has its own reference (see vref.c)
+	if( vref && working_vref != vref)	// Not needed when only X moves on its own
+	{
+		working_vref = vref;	// update working_vref for XYZ drive (see vref.c)
+		SET_VREF(settle);		// write vref HW (see vref.c)
+	}
+
+	if((system_status & 0x08) != 0x08)
+	{
+		system_status |= xyz_moving;  // Drives running
+		if(X_delta) RA0 = 1;	// Enable X RESET Line
+		if(Y_delta) RA1 = 1;	// Enable Y RESET Line
+		if(Z_delta) RA3 = 1;	// Enable Z RESET Line
+		if(X_delta) limit_hit &= 0b11111100;	// No X hit yet (see XYZ_LIMIT)
+		if(Y_delta) limit_hit &= 0b11110011;	// No Y hit yet
+		if(Z_delta) limit_hit &= 0b11001111;	// No Z hit yet
+		xyz_mode = 1;	// Timer2 steps XYZ (see isr in main.c)
+		drive_reset_ms = DRIVE_RESET_MS;	// Delay for RESET/Enable
+		drive_starting |= 0x10;	// Timer2 started by DRIVE_GO (see isr)
+	}
+
+}	// End of XYZ_DRIVE function
+
+// This function, XYZ_DRIVE_DONE is polled by the motion scheduler
+// (see motion.c) while XYZ_DRIVE is running.  It disables the drives
+// once the longest axis has made all its steps, a limit switch of any
+// moving axis stopped them (see XYZ_LIMIT) or a drive was aborted.
+// It returns 1 when the move is over.
+unsigned char XYZ_DRIVE_DONE(void)
+{
+	if( xyz_to_go && ((system_status & xyz_moving) == xyz_moving))
+		return 0;	// Still driving, XYZ_LIMIT stops it at a switch
+
+	TRG_ABORT(); // Disable Drives and interrupts
+	return 1;
+
+}	// End of XYZ_DRIVE_DONE function
+
+//  This is the serial interface to drive XYZ to a new location together.
+//  The format is:
+//	[0] [1] [2] 'SNA' - Send All to New location
+//  [3] X_new_location MSB
+//  [4] X_new_location LSB
+//  [5] Y_new_location MSB
+//  [6] Y_new_location LSB
+//  [7] Z_new_location MSB
+//  [8] Z_new_location LSB
+//  or [3] to [14] X, Y and Z signed 32 bit, MSB first ('15SNA')
+//  The drive is queued and runs after the moves before it (see motion.c)
+void send_new_XYZ(void)
+{
+	MOTION_ADD(MOTION_DRIVE_XYZ);	// X, Y and Z_new_location (see motion.c)
+
+}	// End of send_new_XYZ function
@@ -0,0 +1,260 @@
+/*
+ * eeprom.c
+ *
+ * Settings and the parked position kept in the data EEPROM (256 bytes
+ * on the PIC16F1933) so they are still there after a power cycle.
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+// Each block starts with EE_MARK and its size and ends with the CRC-8
+// (see crc8 in ser.c) of the data in between, so a block written by
+// other firmware or cut short by a power loss is not used.
+//
+//	EE_SETTINGS		EE_MARK, EE_SETTINGS_SIZE, the ee_int settings (MSB
+//					first), the ee_char settings, flags, CRC-8
+//	EE_PARK			EE_MARK, EE_PARK_SIZE, X, Y and Z location (signed 32
+//					bit, MSB first), CRC-8
+//
+// The settings are loaded at power up (see main.c).  The parked
+// position is written by 'NP' once the drives are stopped and its
+// EE_MARK is cleared when the next move starts (see MOTION_RUN in
+// motion.c), so it is only there while the axes have not moved since.
+// 'NI' then skips homing.  A write is about 4 mSec a byte, only bytes
+// that changed are written and the EE_MARK is only cleared (see
+// EE_CHANGE) once one of them is about to be.
+	volatile unsigned int * const ee_int[EE_INTS] = {
+		&X_max_speed, &Y_max_speed, &Z_max_speed,		// (see drive_timer.c)
+		&X_min_speed, &Y_min_speed, &Z_min_speed,
+		&X_accel, &Y_accel, &Z_accel,					// (see drive_ramp.c)
+		&X_vref_settle, &Y_vref_settle, &Z_vref_settle,	// (see vref.c)
+		&X_home_speed, &Y_home_speed, &Z_home_speed,	// (see drive_home.c)
+		&X_full_near, &Y_full_near, &Z_full_near		// (see drive_mode.c)
+	};
+
+	volatile unsigned char * const ee_char[EE_CHARS] = {
+		&X_vref, &Y_vref, &Z_vref,						// (see vref.c)
+		&X_scurve_steps, &Y_scurve_steps, &Z_scurve_steps	// (see drive_ramp.c)
+	};
+
+	volatile bit parked = 0;	// EE_PARK holds the position the axes are at
+
+// This function, EE_WRITE writes one byte of the data EEPROM if it is
+// not already there.  It returns 1 if it was written.
+unsigned char EE_WRITE(unsigned char addr, unsigned char data)
+{
+	if(eeprom_read(addr) == data)
+		return 0;
+
+	eeprom_write(addr, data);	// Waits for the last write to finish
+	return 1;
+
+}	// End of EE_WRITE function
+
+// This function, EE_CHANGE writes one byte of the block at block, after
+// clearing its EE_MARK, if it is not already there.  It returns the
+// number of bytes written.
+unsigned char EE_CHANGE(unsigned char block, unsigned char addr, unsigned char data)
+{
+	if(eeprom_read(addr) == data)
+		return 0;
+
+	return EE_WRITE(block, 0x00) + EE_WRITE(addr, data);	// Not valid until the EE_MARK is back
+
+}	// End of EE_CHANGE function
+
+// This function, EE_VALID checks the mark, size and CRC-8 of the block
+// at addr.  It returns 1 if the block can be used.
+unsigned char EE_VALID(unsigned char addr, unsigned char size)
+{
+	unsigned char crc = 0x00;
+
+	if(eeprom_read(addr) != EE_MARK || eeprom_read(addr + 1) != size)
+		return 0;
+
+	for( unsigned char a = 2; a < size - 1; a++)
+		crc = crc8(crc, eeprom_read(addr + a));
+
+	return crc == eeprom_read(addr + size - 1);
+
+}	// End of EE_VALID function
+
+// This function, EE_LOAD sets the settings saved by 'NW' and finds out
+// if the axes were parked.  It is called once at power up (see main.c),
+// without saved settings the RAM defaults are kept.
+void EE_LOAD(void)
+{
+	unsigned char addr = EE_SETTINGS + 2;
+	unsigned char flags;
+
+	parked = EE_VALID(EE_PARK, EE_PARK_SIZE);
+
+	if(!EE_VALID(EE_SETTINGS, EE_SETTINGS_SIZE))
+		return;
+
+	for( unsigned char a = 0; a < EE_INTS; a++, addr += 2)
+		*ee_int[a] = (eeprom_read(addr) << 8) | eeprom_read(addr + 1);
+
+	for( unsigned char a = 0; a < EE_CHARS; a++)
+		*ee_char[a] = eeprom_read(addr++);
+
+	flags = eeprom_read(addr);
+	X_vref_pwm = (flags & 0x01) ? 1 : 0;	// (see vref.c)
+	Z_step_pwm = (flags & 0x02) ? 1 : 0;	// (see drive_pwm.c)
+	home_z_first = (flags & 0x04) ? 1 : 0;	// (see drive_home.c)
+	motion_events = (flags & 0x08) ? 1 : 0;	// (see motion.c)
+
+}	// End of EE_LOAD function
+
+// This function, UNPARK clears the EE_PARK mark before a move starts
+// (see MOTION_RUN in motion.c).  Only the first move after 'NP' writes.
+void UNPARK(void)
+{
+	if(parked)
+	{
+		EE_WRITE(EE_PARK, 0x00);
+		parked = 0;
+	}
+
+}	// End of UNPARK function
+
+//  This is the serial interface to save the settings.  The format is:
+//	[0] [1] 'NW' - Non-volatile Write settings
+//  returns 1 char, the number of bytes that had to be written, once
+//  they are all in (up to about 200 mSec), or 0xFF if a move is running
+//  or queued or a new baud rate is waiting for 'BC'.  The main loop
+//  waits on the EEPROM the whole time, so the moves would not be started
+//  or finished (see motion.c) and the 'BC' window could run out before
+//  BAUD_SERVICE sees the confirm (see baud.c).
+void write_settings(void)
+{
+	unsigned char addr = EE_SETTINGS + 2;
+	unsigned char crc = 0x00;
+	unsigned char data;
+	unsigned char written = 0;
+
+	if(motion_job != MOTION_IDLE || motion_queue_count || (system_status & 0x70) || baud_pending)
+	{
+		SendStart(1);		// Returning one char
+		SendByte(0xFF);		// Not now (see ser.c)
+		SendEnd();
+		return;
+	}
+
+	written += EE_CHANGE(EE_SETTINGS, EE_SETTINGS + 1, EE_SETTINGS_SIZE);
+
+	for( unsigned char a = 0; a < EE_INTS; a++)
+	{
+		data = *ee_int[a] >> 8;
+		crc = crc8(crc, data);
+		written += EE_CHANGE(EE_SETTINGS, addr++, data);
+		data = *ee_int[a] & 0x00FF;
+		crc = crc8(crc, data);
+		written += EE_CHANGE(EE_SETTINGS, addr++, data);
+	}
+
+	for( unsigned char a = 0; a < EE_CHARS; a++)
+	{
+		data = *ee_char[a];
+		crc = crc8(crc, data);
+		written += EE_CHANGE(EE_SETTINGS, addr++, data);
+	}
+
+	data = 0x00;
+	if(X_vref_pwm) data |= 0x01;
+	if(Z_step_pwm) data |= 0x02;
+	if(home_z_first) data |= 0x04;
+	if(motion_events) data |= 0x08;
+	crc = crc8(crc, data);
+	written += EE_CHANGE(EE_SETTINGS, addr++, data);
+
+	written += EE_CHANGE(EE_SETTINGS, addr, crc);
+	written += EE_WRITE(EE_SETTINGS, EE_MARK);
+
+	SendStart(1);			// Returning one char
+	SendByte(written);
+	SendEnd();				// (see ser.c)
+
+}	// End of write_settings function
+
+//  This is the serial interface to go back to the RAM defaults at the
+//  next power up.  The format is:
+//	[0] [1] 'NE' - Non-volatile Erase settings
+void erase_settings(void)
+{
+	EE_WRITE(EE_SETTINGS, 0x00);
+
+}	// End of erase_settings function
+
+//  This is the serial interface to save the position before the power
+//  is turned off.  The format is:
+//	[0] [1] 'NP' - Non-volatile Park
+//  returns 1 char, 1 parked or 0 if a move is running or queued
+void write_park(void)
+{
+	unsigned char crc = 0x00;
+	unsigned char data[4 * AXIS_COUNT];
+
+	if(motion_job != MOTION_IDLE || motion_queue_count || (system_status & 0x70) || baud_pending)
+	{
+		SendStart(1);		// Returning one char
+		SendByte(0);		// Not now (see ser.c)
+		SendEnd();
+		return;
+	}
+
+	for( unsigned char a = 0; a < AXIS_COUNT; a++)
+	{
+		data[4 * a] = *axes[a].location_hi >> 8;
+		data[4 * a + 1] = *axes[a].location_hi & 0x00FF;
+		data[4 * a + 2] = *axes[a].location >> 8;
+		data[4 * a + 3] = *axes[a].location & 0x00FF;
+	}
+
+	EE_CHANGE(EE_PARK, EE_PARK + 1, EE_PARK_SIZE);
+	for( unsigned char a = 0; a < 4 * AXIS_COUNT; a++)
+	{
+		crc = crc8(crc, data[a]);
+		EE_CHANGE(EE_PARK, EE_PARK + 2 + a, data[a]);
+	}
+	EE_CHANGE(EE_PARK, EE_PARK + EE_PARK_SIZE - 1, crc);
+	EE_WRITE(EE_PARK, EE_MARK);
+
+	parked = 1;
+
+	SendStart(1);			// Returning one char
+	SendByte(1);
+	SendEnd();				// (see ser.c)
+
+}	// End of write_park function
+
+//  This is the serial interface to start up from the parked position.
+//  The format is:
+//	[0] [1] 'NI' - Non-volatile Initialize
+//  If the axes were parked and have not moved since, the locations are
+//  taken from EE_PARK and the FW version is returned at once (see
+//  send_version in initialize.c).  Otherwise it is the same as 'I'.
+void initialize_parked(void)
+{
+	if(!parked || !EE_VALID(EE_PARK, EE_PARK_SIZE))
+	{
+		initialize();	// HOME (see initialize.c)
+		return;
+	}
+
+	TRG_ABORT();			// Abort all XYZ movement (see abort.c)
+	MOTION_CLEAR();			// Forget queued moves (see motion.c)
+	clear_system_status();	// Clear system status (see system_status.c)
+	clear_limit_status();	// Clear limit status (see system_status.c)
+
+	for( unsigned char a = 0, addr = EE_PARK + 2; a < AXIS_COUNT; a++, addr += 4)
+	{
+		*axes[a].new_location_hi = *axes[a].location_hi = ((signed char)eeprom_read(addr) << 8) | eeprom_read(addr + 1);
+		*axes[a].new_location = *axes[a].location = (eeprom_read(addr + 2) << 8) | eeprom_read(addr + 3);
+	}
+
+	send_version();	// (see initialize.c)
+
+}	// End of initialize_parked function
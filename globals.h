@@ -1,135 +1,414 @@
-/*
- * global.h
- * This file contains the definitions of items needing to be used by
- * multiple functions.
-*/
-#include <pic.h>
-#include <htc.h>
-
-// Using Internal Clock of 32 Mhz
-	#define FOSC 32000000L
-	
-	extern volatile unsigned int gbl_ms_Timer;	// Used when Pre-Scaler value of '0b100' equals 1:32.  With a FOCS of
-												// 32 mHz, the Timer0 Flag will be set every 1.024 mSec.
-												// 1.024 = (1/(32M/4))* ( 256: TIMER0 is 8 bit) * (Pre-Scale: 32)
-	
-	extern volatile bit ms_Timer_flag;	// mSec Timer flag used by the timer 0 interrupt to detirmine
-										// which global timer gets updated.
-										
-// abort.c
-	extern void TRG_ABORT(void); 	// Disables XYZ drives and Timers
-	extern void X_ABORT(void);		// Disables X drive and Timer
-	extern void Y_ABORT(void);		// Disables Y drive and Timer
-	extern void Z_ABORT(void);		// Disables Z drive and Timer
-	
-// drive_home.c
-	extern void X_HOME(void);		// Stepper Drive to HOME (X-H RC0 = Low)
-	extern void Y_HOME(void);		// Stepper Drive to HOME (Y-H RC2 = Low)
-	extern void Z_HOME(void);		// Stepper Drive to HOME (Z-H RC4 = Low)
-	
-// drive_mode.c
-	extern void X_HALF_STEP(void);	// X HALF STEP MODE (default drive mode)
-	extern void Y_HALF_STEP(void);	// Y HALF STEP MODE (default drive mode)
-	extern void Z_HALF_STEP(void);	// Z HALF STEP MODE (default drive mode)
-	
-	extern void X_RESET(void); // X translator to HOME (state 1, ABCD = 0101)
-	extern void Y_RESET(void); // Y translator to HOME (state 1, ABCD = 0101)
-	extern void Z_RESET(void); // Z translator to HOME (state 1, ABCD = 0101)
-
-// drive_motor.c
-	extern volatile unsigned int X_new_location;  	// this is the new X axis location from X_Home
-	extern volatile unsigned int Y_new_location;  	// this is the new Y axis location from Y_Home
-	extern volatile unsigned int Z_new_location;  	// this is the new Z axis location from Z_Home
-	
-	extern void X_DRIVE(void);	// Drive X axis to X_new_location
-	extern void Y_DRIVE(void);	// Drive Y axis to Y_new_location
-	extern void Z_DRIVE(void);	// Drive Z axis to Z_new_location
-	
-	// serial com access
-		extern void send_new_X(void); // Write X_new_location & call X_DRIVE
-		extern void send_new_Y(void); // Write Y_new_location & call Y_DRIVE 
-		extern void send_new_Z(void); // Write Z_new_location & call Z_DRIVE
-		
-// drive_start.c
-	extern volatile unsigned int X_location;  	// this is the X axis current location from X_Home
-	extern volatile unsigned int Y_location;  	// this is the Y axis current location from Y_Home
-	extern volatile unsigned int Z_location;  	// this is the Z axis cureent location from Z_Home
-	
-	extern void X_START(void);	// Setup Timers and Drive for X stepper
-	extern void Y_START(void);	// Setup Timers and Drive for Y stepper
-	extern void Z_START(void);	// Setup Timers and Drive for Z stepper
-	
-	// serial com access
-		extern void read_X_position(void);	// This is the current X location with respect to HOME
-		extern void read_Y_position(void);	// This is the current Y location with respect to HOME
-		extern void read_Z_position(void);	// This is the current Z location with respect to HOME
-		
-		extern void write_X_position(void);
-		extern void write_Y_position(void);
-		extern void write_Z_position(void);
-	
-// drive_timer.c
-	extern volatile unsigned int X_max_speed;  	// this will X axis max step frequency
-	extern volatile unsigned int Y_max_speed;  	// this will Y axis max step frequency
-	extern volatile unsigned int Z_max_speed;  	// this will Z axis max step frequency
-	
-	volatile unsigned int X_min_speed;  	// this will X axis min step frequency
-	volatile unsigned int Y_min_speed;  	// this will Y axis min step frequency
-	volatile unsigned int Z_min_speed;  	// this will Z axis min step frequency
-	
-	extern void SET_TIMERS(void);	// Set drive timers with 8 uSec resolution
-	extern unsigned char get_period(unsigned int speed); // Get Compare Period Value
-	extern void msDelay(unsigned int msTime);	// Timer0 mSec Delay with interrupts active
-	
-	// serial com access
-		extern void write_X_fast(void);	// Set X_max_speed
-		extern void write_Y_fast(void);	// Set Y_max_speed
-		extern void write_Z_fast(void);	// Set Y_max_speed
-		extern void write_X_slow(void);	// Set X_min_speed
-		extern void write_Y_slow(void);	// Set Y_min_speed
-		extern void write_Z_slow(void);	// Set Y_min_speed
-
-// Initialize_PIC.c
-	extern void initialize(void);	// Drive XYZ to Home and return FW version on Serial Interface
-	
-// Serial Interface defs (ser.c)
-	#define SER_BUFFER_SIZE		16	// Transmit and Receive Buffer Size
-	extern volatile unsigned char rxfifo[SER_BUFFER_SIZE];		// Receive Buffer
-	extern volatile bank1 unsigned char txfifo[SER_BUFFER_SIZE];// Transmit Buffer
-	extern volatile int RX_Size;	// Receiver number of chars in message
-	
-	extern void SendData(void);		// Transmit data function (see ser.c)
-	extern void Execute(void);		// Execute Received request (see ser.c)
-
-// system_status.c
-	extern volatile unsigned char system_status; 	// Contains System Status Info
-	extern volatile unsigned char limit_status; 	// Contains XYZ limit Switch Info
-	
-	extern void read_limit_status(void);	// Read limit_status
-	extern void tx_read_limit_status(void); // Read limit_status and transmit value
-	extern void read_system_status(void);	// Read system_status
-												
-	extern void clear_limit_status(void);	// Clear limit_status
-	extern void clear_system_status(void);	// Clear system_status
-
-// vref.c
-	extern volatile unsigned char X_vref;		// X Drive Ref Limit
-	extern volatile unsigned char Y_vref;		// Y Drive Ref Limit
-	extern volatile unsigned char Z_vref;		// Z Drive Ref Limit
-	extern volatile unsigned char working_vref;	// Current Ref executing
-	
-	// To Set HW DACOUT
-	extern void SET_VREF(void); // Sets DACOUT to working_vref value
-	
-	// serial com access
-		extern void write_X_VREF(void);	// Write X_ref & call SET_VREF via Serial Interface
-		extern void write_Y_VREF(void);	// Write X_ref & call SET_VREF via Serial Interface
-		extern void write_Z_VREF(void);	// Write X_ref & call SET_VREF via Serial Interface
-
-		extern void read_X_VREF(void);	// Read X_ref via Serial Interface
-		extern void read_Y_VREF(void);	// Read Y_ref via Serial Interface
-		extern void read_Z_VREF(void);	// Read Z_ref via Serial Interface
-		extern void read_VREF(void);	// Read working_vref via Serial Interface
-		
-
-
+/*
+ * global.h
+ * This file contains the definitions of items needing to be used by
+ * multiple functions.
+*/
+#include <pic.h>
+#include <htc.h>
+
+// The firmware waits (main loop and polling loops) at HAL_IDLE().  It
+// does nothing on the PIC, the host build lets simulated time pass
+// there (see host/pic.h).
+#ifndef HAL_IDLE
+	#define HAL_IDLE()
+#endif
+
+// Using Internal Clock of 32 Mhz
+	#define FOSC 32000000L
+	
+	extern volatile unsigned int gbl_ms_Timer;	// Used when Pre-Scaler value of '0b100' equals 1:32.  With a FOCS of
+												// 32 mHz, the Timer0 Flag will be set every 1.024 mSec.
+												// 1.024 = (1/(32M/4))* ( 256: TIMER0 is 8 bit) * (Pre-Scale: 32)
+	
+	extern volatile bit ms_Timer_flag;	// mSec Timer flag used by the timer 0 interrupt to detirmine
+										// which global timer gets updated.
+										
+// axis.c
+// One descriptor per axis (see axis.c).  The serial commands, the motion
+// scheduler and the drive, abort and homing code work on an axis through
+// it, the step interrupts stay written out per axis.  X, Y and Z only.
+	#define AXIS_COUNT		3	// Entries in axes (not a setting, see axis.c)
+	#define AXIS_INDEX(name)	((unsigned char)((name) - 'X'))	// axes[] is in name order
+
+	typedef struct
+	{
+		unsigned char name;			// Axis char of the serial commands
+		unsigned char running;		// Its system_status running bit (see HOME)
+		unsigned char limits;		// Its HOME and FFH switches (PORTC, limit_hit)
+		unsigned char drive_job;	// Its MOTION_DRIVE_ job (see motion.c)
+		unsigned char home_job;		// Its MOTION_HOME_ job
+
+		volatile unsigned short *location;		// (see drive_start.c)
+		volatile short *location_hi;
+		volatile unsigned short *new_location;	// (see drive_motor.c)
+		volatile short *new_location_hi;
+		volatile long *hit_location;			// (see system_status.c)
+
+		volatile unsigned int *max_speed;		// (see drive_timer.c)
+		volatile unsigned int *min_speed;
+		volatile unsigned int *accel;			// (see drive_ramp.c)
+		volatile unsigned char *scurve_steps;
+		volatile unsigned int *full_near;		// (see drive_mode.c)
+		volatile unsigned char *vref;			// (see vref.c)
+		volatile unsigned int *vref_settle;
+		volatile unsigned int *home_speed;		// (see drive_home.c)
+		volatile unsigned char *home_phase;
+		unsigned char *home_tries;
+		volatile unsigned int *speed;			// (see drive_ramp.c)
+		volatile unsigned int *ramp_steps;
+		volatile unsigned char *curve_index;
+		volatile unsigned char *curve_count;
+
+		volatile unsigned char *tmr;	// Its step timer TMRx
+		volatile unsigned char *pr;		// PRx
+		volatile unsigned char *tcon;	// TxCON (TMRxON 0x04)
+		volatile unsigned char *pie;	// PIE1 or PIE3
+		unsigned char tmrie;			// Its TMRxIE in pie
+		volatile unsigned char *port;	// Its L297 STEP, DIR, HALF/FULL and CONTROL port
+		unsigned char step;				// STEP pin on port
+		unsigned char dir;				// DIR pin on port (1 clockwise)
+		unsigned char half;				// HALF/FULL pin on port (1 HALF)
+		unsigned char control;			// CONTROL pin on port
+		unsigned char reset;			// RESET/Enable pin on PORTA
+	} axis_t;
+
+	extern const axis_t axes[AXIS_COUNT];	// X, Y and Z
+
+// abort.c
+	extern void TRG_ABORT(void); 	// Disables XYZ drives and Timers
+	extern void AXIS_ABORT(const axis_t *axis);	// Disables its drive and Timer
+
+	// serial com access
+		extern void abort_all(void);	// Forget queued moves and abort XYZ
+		extern void abort_axis(const axis_t *axis);	// Forget queued moves and abort one axis
+	
+// drive_home.c
+	#define HOME_IDLE		0	// Not homing, or HOME
+	#define HOME_WAIT		1	// Waiting for Z HOME (home_z_first)
+	#define HOME_SEEK		2	// Towards the switch at min_speed
+	#define HOME_BACKOFF	3	// Off the switch
+	#define HOME_APPROACH	4	// Slow back to the switch
+	#define HOME_BACKOFF_STEPS	100	// Half steps driven off the switch
+	#define HOME_TRIES		4	// Back offs before giving up on a stuck switch
+
+	extern volatile unsigned int X_home_speed;	// X step frequency for the approach
+	extern volatile unsigned int Y_home_speed;	// Y step frequency for the approach
+	extern volatile unsigned int Z_home_speed;	// Z step frequency for the approach
+	extern volatile unsigned char X_home_phase;	// X homing phase
+	extern volatile unsigned char Y_home_phase;	// Y homing phase
+	extern volatile unsigned char Z_home_phase;	// Z homing phase
+	extern unsigned char X_home_tries;	// X back offs made
+	extern unsigned char Y_home_tries;	// Y back offs made
+	extern unsigned char Z_home_tries;	// Z back offs made
+	extern volatile bit home_z_first;			// X and Y wait for Z HOME
+
+	extern void HOME(unsigned char running);	// Home axes (0x10 X, 0x20 Y, 0x40 Z) together
+	extern unsigned char HOME_DONE(void);	// Poll HOME, 1 when done
+	extern unsigned char AXIS_HOME_BEGIN(const axis_t *axis);	// Start its seek (HOME switch Low)
+	extern unsigned char AXIS_HOME_BACKOFF(const axis_t *axis);	// Drive it off its HOME switch
+	extern unsigned char AXIS_HOME_POLL(const axis_t *axis);	// Its next homing phase
+
+	// serial com access
+		extern void write_home_speed(const axis_t *axis);	// Set its home_speed
+		extern void write_home_order(void);		// Set home_z_first
+		extern void send_home_all(void);		// Queue HOME of XYZ
+		extern void send_home(const axis_t *axis);	// Queue HOME of one axis
+	
+// drive_mode.c
+	extern volatile unsigned int X_full_near;	// X half steps from X_new_location in HALF step
+	extern volatile unsigned int Y_full_near;	// Y half steps from Y_new_location in HALF step
+	extern volatile unsigned int Z_full_near;	// Z half steps from Z_new_location in HALF step
+
+	extern void PIN_WRITE(volatile unsigned char *port, unsigned char pins, unsigned char level);	// Set or clear pins of a port the isr writes
+	extern void AXIS_HALF_STEP(const axis_t *axis);	// HALF STEP MODE (default drive mode)
+	extern unsigned char AXIS_FULL_TRAVERSE(const axis_t *axis);	// FULL STEP to near its new_location
+	extern void AXIS_RESET(const axis_t *axis); // Its translator to HOME (state 1, ABCD = 0101)
+
+	// serial com access
+		extern void write_full_near(const axis_t *axis);	// Write its full_near
+
+// drive_motor.c
+	extern volatile unsigned short X_new_location;  	// this is the new X axis location from X_Home
+	extern volatile unsigned short Y_new_location;  	// this is the new Y axis location from Y_Home
+	extern volatile unsigned short Z_new_location;  	// this is the new Z axis location from Z_Home
+	extern volatile short X_new_location_hi;	// High word of the new X location
+	extern volatile short Y_new_location_hi;	// High word of the new Y location
+	extern volatile short Z_new_location_hi;	// High word of the new Z location
+	
+	extern void AXIS_DRIVE(const axis_t *axis);	// Start it to its new_location
+	extern unsigned char AXIS_DRIVE_DONE(const axis_t *axis);	// Poll its drive, 1 when done
+	
+	// serial com access
+		extern void send_new(const axis_t *axis); // Queue its drive to new location
+		
+// drive_start.c
+	extern volatile unsigned short X_location;  	// this is the X axis current location from X_Home
+	extern volatile unsigned short Y_location;  	// this is the Y axis current location from Y_Home
+	extern volatile unsigned short Z_location;  	// this is the Z axis cureent location from Z_Home
+	extern volatile short X_location_hi;	// High word of the X location (signed 32 bit, see drive_start.c)
+	extern volatile short Y_location_hi;	// High word of the Y location
+	extern volatile short Z_location_hi;	// High word of the Z location
+	extern volatile unsigned char location_seq;	// Bumped by the isr with every location change
+	
+	#define DRIVE_RESET_MS		10	// mSec from RESET/Enable to the first STEP
+
+	extern volatile unsigned char drive_starting;	// Drives waiting to start (system_status bits)
+	extern volatile unsigned char drive_reset_ms;	// mSec left of the RESET/Enable delay
+
+	extern void AXIS_START(const axis_t *axis, unsigned int speed);	// Setup Timer and Drive for its stepper
+	extern void DRIVE_GO(void);	// Start the waiting drives (called from isr)
+	extern long POSITION(short hi, unsigned short lo);	// Signed 32 bit location from its two words
+	extern long LOCATION(volatile unsigned short *location, volatile short *location_hi);	// Read a location the isr changes
+	extern void tx_location(long at);	// Send a 32 bit location, 4 chars of a frame
+	
+	// serial com access
+		extern void read_position(const axis_t *axis);	// This is its current location with respect to HOME
+		extern void read_position_long(const axis_t *axis);	// All 32 bits of its location
+		
+		extern void write_position(const axis_t *axis);
+	
+// drive_ramp.c
+	#define SCURVE_SIZE		64	// Entries in the S-curve table
+
+	extern volatile unsigned int X_accel;	// X axis step frequency change per step (Hz/step)
+	extern volatile unsigned int Y_accel;	// Y axis step frequency change per step (Hz/step)
+	extern volatile unsigned int Z_accel;	// Z axis step frequency change per step (Hz/step)
+
+	extern volatile unsigned int X_speed;	// X axis step frequency currently running
+	extern volatile unsigned int Y_speed;	// Y axis step frequency currently running
+	extern volatile unsigned int Z_speed;	// Z axis step frequency currently running
+
+	extern volatile unsigned int X_ramp_steps;	// X steps spent accelerating
+	extern volatile unsigned int Y_ramp_steps;	// Y steps spent accelerating
+	extern volatile unsigned int Z_ramp_steps;	// Z steps spent accelerating
+
+	extern volatile unsigned char ramp_on;	// Drives ramping (system_status bits)
+
+	extern const unsigned char scurve[SCURVE_SIZE];	// S-curve speed table
+	extern volatile unsigned char X_scurve_steps;	// X half steps per scurve entry (0 linear)
+	extern volatile unsigned char Y_scurve_steps;	// Y half steps per scurve entry (0 linear)
+	extern volatile unsigned char Z_scurve_steps;	// Z half steps per scurve entry (0 linear)
+	extern volatile unsigned char X_curve_index;	// X scurve entry running
+	extern volatile unsigned char Y_curve_index;	// Y scurve entry running
+	extern volatile unsigned char Z_curve_index;	// Z scurve entry running
+	extern volatile unsigned char X_curve_count;	// X half steps made in the entry
+	extern volatile unsigned char Y_curve_count;	// Y half steps made in the entry
+	extern volatile unsigned char Z_curve_count;	// Z half steps made in the entry
+
+	extern void X_RAMP(void);	// Update X speed after a step (called from isr)
+	extern void Y_RAMP(void);	// Update Y speed after a step (called from isr)
+	extern void Z_RAMP(void);	// Update Z speed after a step (called from isr)
+	extern unsigned int scurve_speed(unsigned int min, unsigned int max, unsigned char index);	// (isr)
+	extern void X_SCURVE(unsigned int to_go, unsigned char steps);	// X S-curve ramp (isr)
+	extern void Y_SCURVE(unsigned int to_go, unsigned char steps);	// Y S-curve ramp (isr)
+	extern void Z_SCURVE(unsigned int to_go, unsigned char steps);	// Z S-curve ramp (isr)
+
+	// serial com access
+		extern void write_accel(const axis_t *axis);	// Set its accel
+		extern void write_scurve(const axis_t *axis);	// Set its scurve_steps
+
+// drive_pwm.c
+	#define MIN_PWM_SPEED		489		// Slowest CCP PWM step frequency (1:64 pre-scale)
+	#define MAX_PWM_SPEED		62500	// Fastest CCP PWM step frequency (128 cycles)
+
+	extern volatile bit Z_step_pwm;	// Z drives step with CCP3
+	extern volatile bit Z_pwm_on;	// CCP3 is driving Z STEP now
+
+	extern unsigned char get_pwm_period(unsigned int speed); // Get PWM Period Value
+	extern unsigned char get_ramp_pwm_period(unsigned int speed); // Get PWM Period Value (isr)
+	extern void Z_PWM_START(unsigned int speed);	// Setup CCP3 and Timer6 for Z STEP
+	extern void Z_PWM_STEP(void);	// Count a Z PWM step (called from isr)
+
+	// serial com access
+		extern void write_Z_step_mode(void);	// Set Z_step_pwm
+
+// drive_xyz.c
+	extern volatile bit xyz_mode;	// Timer2 is stepping XYZ together
+
+	extern unsigned char XYZ_LIMIT(void);	// Stop XYZ at a switch ahead (called from isr)
+	extern void XYZ_STEP(void);		// Step XYZ together (called from isr)
+	extern void XYZ_DRIVE(void);	// Start XYZ together to X/Y/Z_new_location
+	extern unsigned char XYZ_DRIVE_DONE(void);	// Poll XYZ drive, 1 when done
+
+	// serial com access
+		extern void send_new_XYZ(void); // Queue XYZ_DRIVE to new location
+
+// drive_timer.c
+	extern volatile unsigned int X_max_speed;  	// this will X axis max step frequency
+	extern volatile unsigned int Y_max_speed;  	// this will Y axis max step frequency
+	extern volatile unsigned int Z_max_speed;  	// this will Z axis max step frequency
+	
+	extern volatile unsigned int X_min_speed;  	// this will X axis min step frequency
+	extern volatile unsigned int Y_min_speed;  	// this will Y axis min step frequency
+	extern volatile unsigned int Z_min_speed;  	// this will Z axis min step frequency
+	
+	#define MIN_STEP_SPEED		16		// Slowest step frequency (largest timer scale)
+	#define MAX_STEP_SPEED		31250	// Fastest step frequency (16 uSec per interrupt)
+
+	extern volatile unsigned char period_tcon;	// TxCON scale from get_period
+	extern volatile unsigned char ramp_tcon;	// TxCON scale from get_ramp_period
+
+	extern void SET_TIMERS(void);	// Set drive timers to a safe start
+	extern unsigned char get_period(unsigned int speed); // Get Compare Period Value
+	extern unsigned char get_ramp_period(unsigned int speed); // Get Compare Period Value (isr)
+	extern void msDelay(unsigned int msTime);	// Timer0 mSec Delay with interrupts active
+	
+	// serial com access
+		extern void write_fast(const axis_t *axis);	// Set its max_speed
+		extern void write_slow(const axis_t *axis);	// Set its min_speed
+
+// eeprom.c
+	#define EE_MARK				0xA5	// First byte of a valid block
+	#define EE_SETTINGS			0x00	// Settings block
+	#define EE_INTS				18		// Settings of two bytes
+	#define EE_CHARS			6		// Settings of one byte
+	#define EE_SETTINGS_SIZE	(2 + 2 * EE_INTS + EE_CHARS + 1 + 1)	// Mark, size, settings, flags, CRC-8
+	#define EE_PARK				0x40	// Parked position block
+	#define EE_PARK_SIZE		(2 + 4 * AXIS_COUNT + 1)	// Mark, size, location of each axis (32 bit), CRC-8
+
+	extern volatile bit parked;	// EE_PARK holds the position the axes are at
+
+	extern unsigned char EE_WRITE(unsigned char addr, unsigned char data);	// Write a byte if it changed
+	extern unsigned char EE_CHANGE(unsigned char block, unsigned char addr, unsigned char data);	// Write a byte of a block if it changed
+	extern unsigned char EE_VALID(unsigned char addr, unsigned char size);	// 1 if the block is good
+	extern void EE_LOAD(void);	// Saved settings at power up
+	extern void UNPARK(void);	// Parked position no longer good (a move starts)
+
+	// serial com access
+		extern void write_settings(void);	// Save the settings
+		extern void erase_settings(void);	// RAM defaults at the next power up
+		extern void write_park(void);		// Save the position
+		extern void initialize_parked(void);	// Parked position or HOME and return FW version
+
+// Initialize_PIC.c
+	extern void initialize(void);	// Drive XYZ to Home and return FW version on Serial Interface
+	extern void send_version(void);	// Return FW version on Serial Interface (see motion.c)
+	
+// motion.c
+	#define MOTION_IDLE			0	// Nothing running
+	#define MOTION_DRIVE_X		1	// AXIS_DRIVE of X running
+	#define MOTION_DRIVE_Y		2	// AXIS_DRIVE of Y running
+	#define MOTION_DRIVE_Z		3	// AXIS_DRIVE of Z running
+	#define MOTION_DRIVE_XYZ	4	// XYZ_DRIVE running
+	#define MOTION_HOME_X		5	// HOME of X running
+	#define MOTION_HOME_Y		6	// HOME of Y running
+	#define MOTION_HOME_Z		7	// HOME of Z running
+	#define MOTION_VERSION		8	// Return FW version after the moves before it
+	#define MOTION_HOME_XYZ		9	// HOME of XYZ together running
+	#define MOTION_QUEUE_SIZE	2	// Moves that can be queued (7 bytes RAM each)
+	#define EVENT_REACHED		1	// Event reason: at the new location or HOME
+	#define EVENT_LIMIT			2	// Event reason: stopped by a limit switch
+	#define EVENT_ABORTED		3	// Event reason: aborted
+
+	extern volatile unsigned char motion_job;			// Move running now
+	extern volatile unsigned char motion_queue_count;	// Moves queued
+	extern volatile bit motion_events;					// Event frame at the end of each move
+
+	extern void MOTION_START(unsigned char job);	// Replace running and queued moves with job
+	extern void MOTION_ADD(unsigned char job);		// Queue a move
+	extern void MOTION_CLEAR(void);					// Forget queued moves
+	extern void MOTION_SERVICE(void);				// Poll moves (called from main)
+	extern void MOTION_EVENT(unsigned char job);	// Event frames for a move that is over
+	extern void AXIS_EVENT(unsigned char axis, long location, long target, unsigned char hit); // One axis event frame
+
+	// serial com access
+		extern void read_motion_queue(void);	// Read queued, free and running moves
+		extern void write_events(void);			// Event frames on or off
+
+// baud.c
+	#define BAUD_COUNT			8		// Entries in baud_brg
+	#define BAUD_CONFIRM_MS		1000	// mSec the host has to confirm a new rate
+
+	extern volatile unsigned char baud_rate;		// Table entry in use
+	extern volatile bit baud_pending;				// New rate waiting for the host 'BC'
+	extern volatile bit baud_timeout;				// baud_confirm_ms ran out
+	extern volatile unsigned int baud_confirm_ms;	// mSec left to confirm a new rate
+
+	extern void SET_BAUD(unsigned char rate);	// Set EUSART to a baud_brg entry
+	extern void BAUD_SERVICE(void);				// Fall back to 19200 (called from main)
+
+	// serial com access
+		extern void write_baud(void);	// Change baud rate
+		extern void confirm_baud(void);	// Keep new baud rate
+
+// Serial Interface defs (ser.c)
+	#define SER_BUFFER_SIZE		16	// Transmit and Receive Buffer Size
+	#define SER_SOF				0x7E	// Start of every frame (see Execute)
+	#define SER_EVENT			0x7D	// Start of an event frame (see SendEvent)
+	#define RX_TIMEOUT_MS		5	// mSec without a char before a frame is dropped
+	extern volatile unsigned char rxfifo[SER_BUFFER_SIZE];		// Receive Buffer
+	extern volatile unsigned char index;	// Receiver frame index (see isr in main.c)
+	extern volatile unsigned char RX_Size;	// Receiver number of chars in message
+	extern volatile unsigned char rx_crc;	// Received CRC-8 of the message
+	extern unsigned int rx_arg;		// 1 or 2 char argument, MSB first (see Execute)
+	extern unsigned char rx_arg_at;	// Where the arguments start in rxfifo
+	extern bit rx_wide;				// Locations are 4 chars (see RX_LOCATION)
+	extern volatile bit rx_ready;	// A complete message is in rxfifo for Execute
+	
+	#define TX_RING_SIZE		16	// Transmit Ring Buffer Size (power of 2)
+	extern volatile bank1 unsigned char txring[TX_RING_SIZE];	// Transmit Ring Buffer
+	extern volatile unsigned char tx_head;	// Next char to transmit (isr)
+	extern volatile unsigned char tx_tail;	// Next free entry (SendByte)
+
+	extern unsigned char crc8(unsigned char crc, unsigned char data);	// CRC-8 of one more char
+	extern void SendStart(unsigned char size);	// Start a frame of size chars (see ser.c)
+	extern void SendEvent(unsigned char size);	// Start an event frame of size chars (see ser.c)
+	extern void SendByte(unsigned char data);	// Queue one char of the frame (see ser.c)
+	extern void SendEnd(void);		// End the frame with its CRC-8 (see ser.c)
+	extern long RX_LOCATION(unsigned char n);	// Location n of the message, 2 or 4 chars in rxfifo
+	extern void Execute(void);		// Execute Received request (see ser.c)
+
+// system_status.c
+	extern volatile unsigned char system_status; 	// Contains System Status Info
+	extern volatile unsigned char limit_status; 	// Contains XYZ limit Switch Info
+	extern volatile unsigned char limit_hit;		// Switches that stopped a drive
+	extern volatile long X_hit_location;	// X location at the last X hit (signed 32 bit)
+	extern volatile long Y_hit_location;	// Y location at the last Y hit (signed 32 bit)
+	extern volatile long Z_hit_location;	// Z location at the last Z hit (signed 32 bit)
+
+	extern unsigned char X_LIMIT(void);		// Stop X at a switch ahead (step isr)
+	extern unsigned char Y_LIMIT(void);		// Stop Y at a switch ahead (step isr)
+	extern unsigned char Z_LIMIT(void);		// Stop Z at a switch ahead (step isr)
+	
+	extern void read_limit_status(void);	// Read limit_status
+	extern void tx_read_limit_status(void); // Read limit_status and transmit value
+	extern void read_system_status(void);	// Read system_status
+	extern void read_limit_hit(void);		// Read limit_hit and the hit locations
+	extern void read_all_status(void);		// Read locations, status and limits in one frame
+												
+	extern void clear_limit_status(void);	// Clear limit_status
+	extern void clear_system_status(void);	// Clear system_status
+
+// vref.c
+	extern volatile unsigned char X_vref;		// X Drive Ref Limit
+	extern volatile unsigned char Y_vref;		// Y Drive Ref Limit
+	extern volatile unsigned char Z_vref;		// Z Drive Ref Limit
+	extern volatile unsigned char working_vref;	// Current Ref executing
+
+	extern volatile unsigned int X_vref_settle;	// mSec for DACOUT to settle on X_vref
+	extern volatile unsigned int Y_vref_settle;	// mSec for DACOUT to settle on Y_vref
+	extern volatile unsigned int Z_vref_settle;	// mSec for DACOUT to settle on Z_vref
+
+	extern volatile unsigned int vref_settle_ms;	// mSec left before DACOUT is stable
+	extern volatile bit vref_ready;					// DACOUT is stable
+	extern volatile unsigned long vref_wait_ms;		// mSec drives were held waiting on DACOUT
+	extern volatile bit X_vref_pwm;					// X VREF from CCP2 PWM on RB3
+	extern volatile bit vref_locked;				// DACOUT set for several drives, START leaves it
+	
+	// To Set HW DACOUT
+	extern void SET_VREF(unsigned int settle); // Sets DACOUT to working_vref value, stable after settle mSec
+	extern void X_VREF_PWM_START(void);	// Sets CCP2 PWM to X_vref, stable after X_vref_settle mSec
+	extern void X_RAMP_VREF_PWM(void);	// Scale CCP2 duty to a new PR2 (called from isr)
+	
+	// serial com access
+		extern void write_axis_VREF(const axis_t *axis);	// Write its vref via Serial Interface
+
+		extern void read_axis_VREF(const axis_t *axis);	// Read its vref via Serial Interface
+		extern void read_VREF(void);	// Read working_vref via Serial Interface
+
+		extern void write_settle(const axis_t *axis);	// Write its vref_settle via Serial Interface
+		extern void read_vref_wait(void);	// Read vref_wait_ms via Serial Interface
+		extern void write_X_vref_source(void);	// Write X_vref_pwm via Serial Interface
+		
+
+
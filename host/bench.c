@@ -0,0 +1,307 @@
+/*
+ * bench.c (host build)
+ *
+ * Benchmarks of the firmware on the simulated fixture (see sim.c).
+ * Every result is one JSON object per line on stdout so runs can be
+ * kept and compared:
+ *
+ *	config			the simulator timing used (see sim.h)
+ *	move			simulated time, steps and step interrupts of a standard set of moves
+ *	moves_total		the whole set
+ *	isr_branch		interrupts and latency per isr branch over the set
+ *	command_latency	last RX char of a command to its first reply char or STEP
+ *	command_rate	'RS' round trips per second through the serial path
+ *	state_read		'RPX', 'RPY', 'RPZ', 'RS' and 'RL' one after the other against one 'RA'
+ *
+ * The cost of each isr branch in PIC cycles is not benchmarked, it needs
+ * an xc8 listing or MPLAB simulator run and neither is part of the host
+ * build, so only its count and latency are printed.
+ *
+ * The simulator timing can be changed on the command line, e.g.
+ *
+ *	xyz_bench idle=12 isr=60
+ *
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../globals.h"
+#include "proto.h"
+
+	extern void fw_main(void);	// main() of main.c (see Makefile)
+
+	static int failures = 0;
+
+static double to_us(sim_cycles_t cycles)
+{
+	return (double)cycles * 1000.0 / SIM_CYCLES_PER_MS;
+}
+
+static void fail(const char *what)
+{
+	printf("{\"bench\":\"error\",\"what\":\"%s\"}\n", what);
+	failures++;
+}
+
+// string.h is left out, its index() would clash with the firmware index
+static int same(const char *a, const char *b)
+{
+	while(*a && *a == *b)
+		a++, b++;
+	return *a == *b;
+}
+
+static void config(int argc, char **argv)
+{
+	for(int a = 1; a < argc; a++)
+	{
+		char *value = argv[a];
+		int found = 0;
+
+		while(*value && *value != '=')
+			value++;
+		if(!*value)
+			value = NULL;
+
+		if(value)
+		{
+			*value++ = '\0';
+			if(same(argv[a], "idle"))
+				sim_idle_cycles = atoi(value), found = 1;
+			else if(same(argv[a], "isr"))
+				sim_isr_cycles = atoi(value), found = 1;
+		}
+
+		if(!found)
+		{
+			fprintf(stderr, "usage: xyz_bench [idle=N] [isr=N]\n");
+			exit(2);
+		}
+	}
+
+	printf("{\"bench\":\"config\",\"idle_cycles\":%u,\"isr_cycles\":%u}\n", sim_idle_cycles, sim_isr_cycles);
+}
+
+// The standard set of moves, run from HOME
+	static const struct
+	{
+		const char *name;
+		const char *msg;
+		unsigned int size;
+	} moves[] = {
+		{ "xyz_out",	"SNA\x07\xD0\x05\xDC\x03\x20", 9 },	// 2000, 1500, 800
+		{ "x_back",		"SNX\x01\xF4", 5 },					// X to 500
+		{ "y_back",		"SNY\x00\x64", 5 },					// Y to 100
+		{ "z_out",		"SNZ\x04\xB0", 5 },					// Z to 1200
+		{ "xyz_diag",	"SNA\x03\xE8\x03\xE8\x03\xE8", 9 },	// 1000, 1000, 1000
+		{ "xyz_home",	"SNA\x00\x00\x00\x00\x00\x00", 9 },	// 0, 0, 0
+	};
+
+static void bench_moves(sim_stats_t *total)
+{
+	sim_cycles_t set_start = sim_cycles;
+	sim_stats_t sum = { 0 };
+
+	for(unsigned int m = 0; m < sizeof(moves) / sizeof(moves[0]); m++)
+	{
+		sim_cycles_t start = sim_cycles;
+		unsigned long steps, step_irqs;
+
+		sim_stats_clear();
+		if(!proto_command(moves[m].msg, moves[m].size) ||
+				!sim_run_until(proto_motion_idle, 60 * SIM_CYCLES_PER_SEC))
+			fail(moves[m].name);
+
+		steps = sim_axis[0].steps + sim_axis[1].steps + sim_axis[2].steps;
+		step_irqs = sim_stats.irq_count[SIM_IRQ_TMR2] + sim_stats.irq_count[SIM_IRQ_TMR4]
+					+ sim_stats.irq_count[SIM_IRQ_TMR6];
+
+		printf("{\"bench\":\"move\",\"name\":\"%s\",\"ms\":%.3f,\"steps\":%lu,\"step_irqs\":%lu}\n",
+				moves[m].name, to_us(sim_cycles - start) / 1000.0, steps, step_irqs);
+
+		// Add up for the isr branches
+		sum.cycles += sim_stats.cycles;
+		for(int s = 0; s < SIM_IRQ_COUNT; s++)
+		{
+			sum.irq_count[s] += sim_stats.irq_count[s];
+			sum.irq_latency_sum[s] += sim_stats.irq_latency_sum[s];
+			if(sim_stats.irq_latency_max[s] > sum.irq_latency_max[s])
+				sum.irq_latency_max[s] = sim_stats.irq_latency_max[s];
+		}
+	}
+
+	printf("{\"bench\":\"moves_total\",\"ms\":%.3f}\n", to_us(sim_cycles - set_start) / 1000.0);
+
+	*total = sum;
+}
+
+static void bench_isr(const sim_stats_t *sum)
+{
+	for(int s = 0; s < SIM_IRQ_COUNT; s++)
+	{
+		printf("{\"bench\":\"isr_branch\",\"branch\":\"%s\",\"count\":%lu,"
+				"\"latency_avg_us\":%.3f,\"latency_max_us\":%.3f}\n",
+				sim_irq_name[s], sum->irq_count[s],
+				sum->irq_count[s] ? to_us(sum->irq_latency_sum[s]) / sum->irq_count[s] : 0.0,
+				to_us(sum->irq_latency_max[s]));
+	}
+}
+
+// Last RX char of 'RS' to the first reply char out
+static void bench_reply_latency(void)
+{
+	sim_cycles_t worst = 0, total = 0;
+	unsigned char data[1];
+	const int runs = 20;
+
+	for(int r = 0; r < runs; r++)
+	{
+		sim_cycles_t sent;
+
+		sim_stats_clear();
+		sim_send_frame((const unsigned char *)"RS", 2);
+		sent = sim_uart_sent_at();
+		if(proto_reply(data, 1, SIM_CYCLES_PER_SEC) != 1 || !sim_stats.tx_first)
+		{
+			fail("RS reply");
+			return;
+		}
+
+		total += sim_stats.tx_first - sent;
+		if(sim_stats.tx_first - sent > worst)
+			worst = sim_stats.tx_first - sent;
+	}
+
+	printf("{\"bench\":\"command_latency\",\"command\":\"RS\",\"to\":\"first_reply_char\",\"baud\":%lu,"
+			"\"avg_us\":%.3f,\"max_us\":%.3f}\n",
+			SIM_CYCLES_PER_SEC / sim_uart_bit_cycles(), to_us(total) / runs, to_us(worst));
+}
+
+// Last RX char of 'SNX' to the first X STEP the L297 takes
+static void bench_step_latency(void)
+{
+	sim_cycles_t sent;
+
+	sim_stats_clear();
+	sim_send_frame((const unsigned char *)"SNX\x00\x64", 5);	// X to 100
+	sent = sim_uart_sent_at();
+
+	if(!sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC) || !sim_axis[0].first_step)
+	{
+		fail("SNX first step");
+		return;
+	}
+
+	printf("{\"bench\":\"command_latency\",\"command\":\"SNX\",\"to\":\"first_step\",\"baud\":%lu,"
+			"\"avg_us\":%.3f,\"max_us\":%.3f}\n",
+			SIM_CYCLES_PER_SEC / sim_uart_bit_cycles(),
+			to_us(sim_axis[0].first_step - sent), to_us(sim_axis[0].first_step - sent));
+
+	// Back to HOME for the next run
+	if(!proto_command("SNX\x00\x00", 5) || !sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC))
+		fail("SNX back");
+}
+
+// 'RS' one after the other, each sent once the last reply is in
+static void bench_rate(void)
+{
+	unsigned char data[1];
+	const int commands = 100;
+	int replies = 0;
+	sim_cycles_t start = sim_cycles;
+
+	for(int c = 0; c < commands; c++)
+	{
+		sim_send_frame((const unsigned char *)"RS", 2);
+		if(proto_reply(data, 1, 100 * SIM_CYCLES_PER_MS) != 1)
+			break;
+		replies++;
+	}
+
+	printf("{\"bench\":\"command_rate\",\"command\":\"RS\",\"baud\":%lu,\"commands\":%d,\"replies\":%d,"
+			"\"ms\":%.3f,\"per_sec\":%.1f}\n",
+			SIM_CYCLES_PER_SEC / sim_uart_bit_cycles(), commands, replies,
+			to_us(sim_cycles - start) / 1000.0,
+			replies * 1e6 / to_us(sim_cycles - start));
+
+	if(replies != commands)
+	{
+		fail("RS replies lost");
+		proto_command("CS", 2);	// Lost commands leave an error
+	}
+}
+
+// The whole state read both ways, each command sent once the last
+// reply is in
+static void bench_state_read(void)
+{
+	static const char *reads[5] = { "RPX", "RPY", "RPZ", "RS", "RL" };
+	static const unsigned int sizes[5] = { 3, 3, 3, 2, 2 };
+	unsigned char data[30];
+	sim_cycles_t start = sim_cycles, singles;
+
+	for(int r = 0; r < 5; r++)
+	{
+		sim_send_frame((const unsigned char *)reads[r], sizes[r]);
+		if(proto_reply(data, 30, 100 * SIM_CYCLES_PER_MS) < 1)
+		{
+			fail("state_read singles");
+			return;
+		}
+	}
+	singles = sim_cycles - start;
+
+	start = sim_cycles;
+	sim_send_frame((const unsigned char *)"RA", 2);
+	if(proto_reply(data, 30, 100 * SIM_CYCLES_PER_MS) != 30)
+	{
+		fail("state_read RA");
+		return;
+	}
+
+	printf("{\"bench\":\"state_read\",\"baud\":%lu,\"singles_us\":%.3f,\"ra_us\":%.3f}\n",
+			SIM_CYCLES_PER_SEC / sim_uart_bit_cycles(), to_us(singles), to_us(sim_cycles - start));
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char version[7];
+	sim_stats_t sum;
+
+	config(argc, argv);
+
+	sim_axis[0].position = 400;
+	sim_axis[1].position = 300;
+	sim_axis[2].position = 200;
+
+	sim_boot(fw_main);
+
+	if(!proto_command("I", 1) || proto_reply(version, 7, 20 * SIM_CYCLES_PER_SEC) != 7)
+	{
+		fail("initialize");
+		return 1;
+	}
+
+	bench_moves(&sum);
+	bench_isr(&sum);
+	bench_reply_latency();
+	bench_step_latency();
+	bench_rate();
+	bench_state_read();
+
+	// Again at the fastest baud rate (see baud.c)
+	if(!proto_baud(BAUD_COUNT - 1))
+		fail("baud change");
+	else
+	{
+		bench_reply_latency();
+		bench_step_latency();
+		bench_rate();
+		bench_state_read();
+		if(!proto_baud(0))
+			fail("baud back");
+	}
+
+	return failures ? 1 : 0;
+}
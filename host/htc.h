@@ -0,0 +1,8 @@
+/*
+ * htc.h (host build)
+ *
+ * Stands in for the HI-TECH <htc.h>, everything is in pic.h.
+ *
+*/
+
+#include <pic.h>
@@ -0,0 +1,258 @@
+/*
+ * pic.h (host build)
+ *
+ * Stands in for the HI-TECH <pic.h> when the firmware is built on the
+ * host (see Makefile).  Every special function register the firmware
+ * uses is a byte in the simulated register file (see sim.c), and the
+ * named bits are bit fields of those bytes so PORTB and RB0 stay the
+ * same storage as they are on the PIC.
+ *
+ * RCREG and TXREG are not plain bytes: reading RCREG takes the next
+ * received char and writing TXREG hands a char to the simulated
+ * transmitter, as on the PIC.
+ *
+ * HAL_IDLE() marks the places the firmware waits (main loop and
+ * polling loops).  On the PIC it is empty (see globals.h), here it
+ * lets simulated time pass, which runs the timers and delivers the
+ * interrupts (see sim_idle in sim.c).
+ *
+*/
+
+#ifndef HOST_PIC_H
+#define HOST_PIC_H
+
+// HI-TECH C keywords and qualifiers
+	#define bit				unsigned char
+	#define interrupt
+	#define bank1
+	#define __CONFIG(x)
+	#define NOP()			((void)0)
+	#define CLRWDT()		((void)0)
+	#define di()			(GIE = 0)
+	#define ei()			(GIE = 1)
+
+// A simulated register.  The bits are named b0 (LSB) to b7.
+	typedef union
+	{
+		unsigned char byte;
+		struct
+		{
+			unsigned char b0 : 1;
+			unsigned char b1 : 1;
+			unsigned char b2 : 1;
+			unsigned char b3 : 1;
+			unsigned char b4 : 1;
+			unsigned char b5 : 1;
+			unsigned char b6 : 1;
+			unsigned char b7 : 1;
+		} bits;
+	} sim_reg_t;
+
+	#define SIM_REG(name)	extern volatile sim_reg_t sim_##name;
+
+// The simulated register file (see sim.c)
+	SIM_REG(PORTA)	SIM_REG(PORTB)	SIM_REG(PORTC)
+	SIM_REG(LATA)	SIM_REG(LATB)	SIM_REG(LATC)
+	SIM_REG(TRISA)	SIM_REG(TRISB)	SIM_REG(TRISC)
+	SIM_REG(ANSELA)	SIM_REG(ANSELB)
+	SIM_REG(INTCON)	SIM_REG(OPTION_REG)	SIM_REG(OSCCON)
+	SIM_REG(PIE1)	SIM_REG(PIE2)	SIM_REG(PIE3)
+	SIM_REG(PIR1)	SIM_REG(PIR2)	SIM_REG(PIR3)
+	SIM_REG(TMR0)
+	SIM_REG(TMR2)	SIM_REG(PR2)	SIM_REG(T2CON)
+	SIM_REG(TMR4)	SIM_REG(PR4)	SIM_REG(T4CON)
+	SIM_REG(TMR6)	SIM_REG(PR6)	SIM_REG(T6CON)
+	SIM_REG(RCSTA)	SIM_REG(TXSTA)	SIM_REG(BAUDCON)
+	SIM_REG(SPBRGL)	SIM_REG(SPBRGH)
+	SIM_REG(FVRCON)	SIM_REG(DACCON0)	SIM_REG(DACCON1)
+	SIM_REG(APFCON)	SIM_REG(CCPTMRS0)	SIM_REG(CCPTMRS1)
+	SIM_REG(CCP1CON)	SIM_REG(CCPR1L)
+	SIM_REG(CCP2CON)	SIM_REG(CCPR2L)
+	SIM_REG(CCP3CON)	SIM_REG(CCPR3L)
+	SIM_REG(CCP4CON)	SIM_REG(CCPR4L)
+	SIM_REG(CCP5CON)	SIM_REG(CCPR5L)
+
+// Registers as bytes
+	#define PORTA		sim_PORTA.byte
+	#define PORTB		sim_PORTB.byte
+	#define PORTC		sim_PORTC.byte
+	#define LATA		sim_LATA.byte
+	#define LATB		sim_LATB.byte
+	#define LATC		sim_LATC.byte
+	#define TRISA		sim_TRISA.byte
+	#define TRISB		sim_TRISB.byte
+	#define TRISC		sim_TRISC.byte
+	#define ANSELA		sim_ANSELA.byte
+	#define ANSELB		sim_ANSELB.byte
+	#define INTCON		sim_INTCON.byte
+	#define OPTION_REG	sim_OPTION_REG.byte
+	#define OSCCON		sim_OSCCON.byte
+	#define PIE1		sim_PIE1.byte
+	#define PIE2		sim_PIE2.byte
+	#define PIE3		sim_PIE3.byte
+	#define PIR1		sim_PIR1.byte
+	#define PIR2		sim_PIR2.byte
+	#define PIR3		sim_PIR3.byte
+	#define TMR0		sim_TMR0.byte
+	#define TMR2		sim_TMR2.byte
+	#define PR2			sim_PR2.byte
+	#define T2CON		sim_T2CON.byte
+	#define TMR4		sim_TMR4.byte
+	#define PR4			sim_PR4.byte
+	#define T4CON		sim_T4CON.byte
+	#define TMR6		sim_TMR6.byte
+	#define PR6			sim_PR6.byte
+	#define T6CON		sim_T6CON.byte
+	#define RCSTA		sim_RCSTA.byte
+	#define TXSTA		sim_TXSTA.byte
+	#define BAUDCON		sim_BAUDCON.byte
+	#define SPBRGL		sim_SPBRGL.byte
+	#define SPBRGH		sim_SPBRGH.byte
+	#define FVRCON		sim_FVRCON.byte
+	#define DACCON0		sim_DACCON0.byte
+	#define DACCON1		sim_DACCON1.byte
+	#define APFCON		sim_APFCON.byte
+	#define CCPTMRS0	sim_CCPTMRS0.byte
+	#define CCPTMRS1	sim_CCPTMRS1.byte
+	#define CCP1CON		sim_CCP1CON.byte
+	#define CCPR1L		sim_CCPR1L.byte
+	#define CCP2CON		sim_CCP2CON.byte
+	#define CCPR2L		sim_CCPR2L.byte
+	#define CCP3CON		sim_CCP3CON.byte
+	#define CCPR3L		sim_CCPR3L.byte
+	#define CCP4CON		sim_CCP4CON.byte
+	#define CCPR4L		sim_CCPR4L.byte
+	#define CCP5CON		sim_CCP5CON.byte
+	#define CCPR5L		sim_CCPR5L.byte
+
+// The receive and transmit data registers (see sim.c)
+	extern unsigned char sim_rcreg_read(void);
+	extern unsigned char *sim_txreg_write(void);
+
+	#define RCREG		sim_rcreg_read()
+	#define TXREG		(*sim_txreg_write())
+
+// PORTA
+	#define RA0			sim_PORTA.bits.b0
+	#define RA1			sim_PORTA.bits.b1
+	#define RA2			sim_PORTA.bits.b2
+	#define RA3			sim_PORTA.bits.b3
+	#define RA4			sim_PORTA.bits.b4
+	#define RA5			sim_PORTA.bits.b5
+	#define RA6			sim_PORTA.bits.b6
+	#define RA7			sim_PORTA.bits.b7
+
+// PORTB
+	#define RB0			sim_PORTB.bits.b0
+	#define RB1			sim_PORTB.bits.b1
+	#define RB2			sim_PORTB.bits.b2
+	#define RB3			sim_PORTB.bits.b3
+	#define RB4			sim_PORTB.bits.b4
+	#define RB5			sim_PORTB.bits.b5
+	#define RB6			sim_PORTB.bits.b6
+	#define RB7			sim_PORTB.bits.b7
+
+// PORTC
+	#define RC0			sim_PORTC.bits.b0
+	#define RC1			sim_PORTC.bits.b1
+	#define RC2			sim_PORTC.bits.b2
+	#define RC3			sim_PORTC.bits.b3
+	#define RC4			sim_PORTC.bits.b4
+	#define RC5			sim_PORTC.bits.b5
+	#define RC6			sim_PORTC.bits.b6
+	#define RC7			sim_PORTC.bits.b7
+
+// INTCON: GIE PEIE TMR0IE INTE IOCIE TMR0IF INTF IOCIF
+	#define GIE			sim_INTCON.bits.b7
+	#define PEIE		sim_INTCON.bits.b6
+	#define TMR0IE		sim_INTCON.bits.b5
+	#define INTE		sim_INTCON.bits.b4
+	#define IOCIE		sim_INTCON.bits.b3
+	#define TMR0IF		sim_INTCON.bits.b2
+	#define INTF		sim_INTCON.bits.b1
+	#define IOCIF		sim_INTCON.bits.b0
+
+// OPTION_REG: WPUEN INTEDG TMR0CS TMR0SE PSA PS<2:0>
+	#define WPUEN		sim_OPTION_REG.bits.b7
+	#define INTEDG		sim_OPTION_REG.bits.b6
+	#define TMR0CS		sim_OPTION_REG.bits.b5
+	#define TMR0SE		sim_OPTION_REG.bits.b4
+	#define PSA			sim_OPTION_REG.bits.b3
+
+// PIE1/PIR1: TMR1GIE ADIE RCIE TXIE SSP1IE CCP1IE TMR2IE TMR1IE
+	#define TMR1GIE		sim_PIE1.bits.b7
+	#define ADIE		sim_PIE1.bits.b6
+	#define RCIE		sim_PIE1.bits.b5
+	#define TXIE		sim_PIE1.bits.b4
+	#define SSP1IE		sim_PIE1.bits.b3
+	#define CCP1IE		sim_PIE1.bits.b2
+	#define TMR2IE		sim_PIE1.bits.b1
+	#define TMR1IE		sim_PIE1.bits.b0
+	#define TMR1GIF		sim_PIR1.bits.b7
+	#define ADIF		sim_PIR1.bits.b6
+	#define RCIF		sim_PIR1.bits.b5
+	#define TXIF		sim_PIR1.bits.b4
+	#define SSP1IF		sim_PIR1.bits.b3
+	#define CCP1IF		sim_PIR1.bits.b2
+	#define TMR2IF		sim_PIR1.bits.b1
+	#define TMR1IF		sim_PIR1.bits.b0
+
+// PIE3/PIR3: - CCP5IE CCP4IE CCP3IE TMR6IE - TMR4IE -
+	#define CCP5IE		sim_PIE3.bits.b6
+	#define CCP4IE		sim_PIE3.bits.b5
+	#define CCP3IE		sim_PIE3.bits.b4
+	#define TMR6IE		sim_PIE3.bits.b3
+	#define TMR4IE		sim_PIE3.bits.b1
+	#define CCP5IF		sim_PIR3.bits.b6
+	#define CCP4IF		sim_PIR3.bits.b5
+	#define CCP3IF		sim_PIR3.bits.b4
+	#define TMR6IF		sim_PIR3.bits.b3
+	#define TMR4IF		sim_PIR3.bits.b1
+
+// TxCON: - TxOUTPS<3:0> TMRxON TxCKPS<1:0>
+	#define TMR2ON		sim_T2CON.bits.b2
+	#define TMR4ON		sim_T4CON.bits.b2
+	#define TMR6ON		sim_T6CON.bits.b2
+
+// RCSTA: SPEN RX9 SREN CREN ADDEN FERR OERR RX9D
+	#define SPEN		sim_RCSTA.bits.b7
+	#define RX9			sim_RCSTA.bits.b6
+	#define SREN		sim_RCSTA.bits.b5
+	#define CREN		sim_RCSTA.bits.b4
+	#define ADDEN		sim_RCSTA.bits.b3
+	#define FERR		sim_RCSTA.bits.b2
+	#define OERR		sim_RCSTA.bits.b1
+	#define RX9D		sim_RCSTA.bits.b0
+
+// TXSTA: CSRC TX9 TXEN SYNC SENDB BRGH TRMT TX9D
+	#define CSRC		sim_TXSTA.bits.b7
+	#define TX9			sim_TXSTA.bits.b6
+	#define TXEN		sim_TXSTA.bits.b5
+	#define SYNC		sim_TXSTA.bits.b4
+	#define SENDB		sim_TXSTA.bits.b3
+	#define BRGH		sim_TXSTA.bits.b2
+	#define TRMT		sim_TXSTA.bits.b1
+	#define TX9D		sim_TXSTA.bits.b0
+
+// BAUDCON: ABDOVF RCIDL - SCKP BRG16 - WUE ABDEN
+	#define ABDOVF		sim_BAUDCON.bits.b7
+	#define RCIDL		sim_BAUDCON.bits.b6
+	#define SCKP		sim_BAUDCON.bits.b4
+	#define BRG16		sim_BAUDCON.bits.b3
+	#define WUE			sim_BAUDCON.bits.b1
+	#define ABDEN		sim_BAUDCON.bits.b0
+
+// APFCON: - CCP3SEL T1GSEL P2BSEL SRNQSEL C2OUTSEL SSSEL CCP2SEL
+	#define CCP3SEL		sim_APFCON.bits.b6
+	#define CCP2SEL		sim_APFCON.bits.b0
+
+// HI-TECH data EEPROM routines (see sim.c)
+	extern unsigned char eeprom_read(unsigned char addr);
+	extern void eeprom_write(unsigned char addr, unsigned char value);
+
+// Host build hook (see sim_idle in sim.c)
+	extern void sim_idle(void);
+
+	#define HAL_IDLE()	sim_idle()
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * proto.c (host build)
+ *
+ * Host side of the serial protocol (see proto.h).
+ *
+*/
+
+#include <stdint.h>
+
+#include "../globals.h"
+#include "proto.h"
+
+int proto_command_taken(void)
+{
+	return !sim_uart_sending() && !index && !rx_ready;
+}
+
+int proto_motion_idle(void)
+{
+	return proto_command_taken() && motion_job == MOTION_IDLE && motion_queue_count == 0;
+}
+
+int proto_command(const char *msg, unsigned int size)
+{
+	sim_send_frame((const unsigned char *)msg, size);
+	return sim_run_until(proto_command_taken, SIM_CYCLES_PER_SEC);
+}
+
+int proto_reply(unsigned char *msg, unsigned int max, sim_cycles_t timeout)
+{
+	sim_cycles_t end = sim_cycles + timeout;
+	int size;
+
+	while((size = sim_recv_frame(msg, max)) == -1 && sim_cycles < end)
+		sim_run(SIM_CYCLES_PER_MS / 8);
+
+	return size;
+}
+
+int proto_event(unsigned char *msg, unsigned int max, sim_cycles_t timeout)
+{
+	sim_cycles_t end = sim_cycles + timeout;
+	int size;
+
+	while((size = sim_recv_event(msg, max)) == -1 && sim_cycles < end)
+		sim_run(SIM_CYCLES_PER_MS / 8);
+
+	return size;
+}
+
+long proto_read_position(char axis)
+{
+	char msg[3] = { 'R', 'P', axis };
+	unsigned char data[2] = { 0, 0 };
+
+	if(!proto_command(msg, 3) || proto_reply(data, 2, SIM_CYCLES_PER_SEC) != 2)
+		return -1;
+	return ((long)data[0] << 8) | data[1];
+}
+
+long proto_location(const unsigned char *data)
+{
+	return (long)(int32_t)(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | (data[2] << 8) | data[3]);
+}
+
+// The host follows the firmware rate (sim_host_bit_cycles = 0), so
+// 'BC' goes out at the new rate once the firmware has changed over.
+int proto_baud(unsigned char rate)
+{
+	char set[3] = { 'B', 'S', (char)rate };
+	unsigned char data[1];
+
+	if(!proto_command(set, 3) || proto_reply(data, 1, SIM_CYCLES_PER_SEC) != 1 || data[0] != rate)
+		return 0;
+
+	sim_run(SIM_CYCLES_PER_MS);	// New rate set once the reply is out (see write_baud)
+
+	if(!proto_command("BC", 2) || proto_reply(data, 1, SIM_CYCLES_PER_SEC) != 1)
+		return 0;
+	return data[0] == rate;
+}
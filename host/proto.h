@@ -0,0 +1,23 @@
+/*
+ * proto.h (host build)
+ *
+ * Host side of the serial protocol (see Execute in ser.c), used by
+ * the regression run and the benchmarks.
+ *
+*/
+
+#ifndef HOST_PROTO_H
+#define HOST_PROTO_H
+
+#include "sim.h"
+
+	extern int proto_command_taken(void);	// The last frame sent has been taken by Execute
+	extern int proto_motion_idle(void);		// Nothing running or queued
+	extern int proto_command(const char *msg, unsigned int size);	// Send a frame, 1 once taken
+	extern int proto_reply(unsigned char *msg, unsigned int max, sim_cycles_t timeout);	// Reply size, -1 none, -2 bad
+	extern int proto_event(unsigned char *msg, unsigned int max, sim_cycles_t timeout);	// Event size, -1 none, -2 bad
+	extern long proto_read_position(char axis);	// 'RPX'/'RPY'/'RPZ', -1 no reply
+	extern long proto_location(const unsigned char *data);	// 4 char signed 32 bit location, MSB first
+	extern int proto_baud(unsigned char rate);	// 'BS' then 'BC' at the new rate, 1 if confirmed
+
+#endif
@@ -0,0 +1,701 @@
+/*
+ * sim.c (host build)
+ *
+ * Simulated PIC16F1933 peripherals and the XYZ fixture (see sim.h).
+ * Every cycle the timers, the CCP3 PWM, the EUSART and the stepper
+ * lines are updated and, when the firmware is waiting at HAL_IDLE()
+ * with GIE set, a pending interrupt calls isr().
+ *
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include <pic.h>
+#include "sim.h"
+
+	extern void isr(void);	// (see main.c)
+
+// The register file (see pic.h)
+	#define SIM_REG_DEF(name)	volatile sim_reg_t sim_##name;
+
+	SIM_REG_DEF(PORTA)	SIM_REG_DEF(PORTB)	SIM_REG_DEF(PORTC)
+	SIM_REG_DEF(LATA)	SIM_REG_DEF(LATB)	SIM_REG_DEF(LATC)
+	SIM_REG_DEF(TRISA)	SIM_REG_DEF(TRISB)	SIM_REG_DEF(TRISC)
+	SIM_REG_DEF(ANSELA)	SIM_REG_DEF(ANSELB)
+	SIM_REG_DEF(INTCON)	SIM_REG_DEF(OPTION_REG)	SIM_REG_DEF(OSCCON)
+	SIM_REG_DEF(PIE1)	SIM_REG_DEF(PIE2)	SIM_REG_DEF(PIE3)
+	SIM_REG_DEF(PIR1)	SIM_REG_DEF(PIR2)	SIM_REG_DEF(PIR3)
+	SIM_REG_DEF(TMR0)
+	SIM_REG_DEF(TMR2)	SIM_REG_DEF(PR2)	SIM_REG_DEF(T2CON)
+	SIM_REG_DEF(TMR4)	SIM_REG_DEF(PR4)	SIM_REG_DEF(T4CON)
+	SIM_REG_DEF(TMR6)	SIM_REG_DEF(PR6)	SIM_REG_DEF(T6CON)
+	SIM_REG_DEF(RCSTA)	SIM_REG_DEF(TXSTA)	SIM_REG_DEF(BAUDCON)
+	SIM_REG_DEF(SPBRGL)	SIM_REG_DEF(SPBRGH)
+	SIM_REG_DEF(FVRCON)	SIM_REG_DEF(DACCON0)	SIM_REG_DEF(DACCON1)
+	SIM_REG_DEF(APFCON)	SIM_REG_DEF(CCPTMRS0)	SIM_REG_DEF(CCPTMRS1)
+	SIM_REG_DEF(CCP1CON)	SIM_REG_DEF(CCPR1L)
+	SIM_REG_DEF(CCP2CON)	SIM_REG_DEF(CCPR2L)
+	SIM_REG_DEF(CCP3CON)	SIM_REG_DEF(CCPR3L)
+	SIM_REG_DEF(CCP4CON)	SIM_REG_DEF(CCPR4L)
+	SIM_REG_DEF(CCP5CON)	SIM_REG_DEF(CCPR5L)
+
+	const char *sim_irq_name[SIM_IRQ_COUNT] = { "tmr0", "tmr2", "tmr4", "tmr6", "rx", "tx" };
+
+	sim_axis_t sim_axis[3];
+	sim_stats_t sim_stats;
+	sim_cycles_t sim_cycles = 0;
+
+	unsigned int sim_idle_cycles = 16;
+	unsigned int sim_isr_cycles = 75;
+	unsigned int sim_host_bit_cycles = 0;
+
+// Firmware and host contexts.  The firmware only hands back to the
+// host at HAL_IDLE() once sim_stop_at is reached.
+	static ucontext_t sim_host_ctx;
+	static ucontext_t sim_fw_ctx;
+	static char sim_fw_stack[1 << 20];
+	static sim_cycles_t sim_stop_at = 0;
+	static sim_cycles_t sim_stall_end = 0;	// Main loop held until (see sim_stall)
+	static int sim_in_isr = 0;
+
+// Timer2/4/6
+	typedef struct
+	{
+		volatile sim_reg_t *tmr;
+		volatile sim_reg_t *pr;
+		volatile sim_reg_t *con;
+		unsigned char last_con;	// Writing TxCON clears the scalers
+		unsigned int pre;		// Pre-scaler count
+		unsigned int post;		// Post-scaler count
+		int rolled;				// TMRx went back to 0 this cycle
+	} sim_timer_t;
+
+	static sim_timer_t sim_timer[3] = {
+		{ &sim_TMR2, &sim_PR2, &sim_T2CON, 0, 0, 0, 0 },
+		{ &sim_TMR4, &sim_PR4, &sim_T4CON, 0, 0, 0, 0 },
+		{ &sim_TMR6, &sim_PR6, &sim_T6CON, 0, 0, 0, 0 },
+	};
+
+	static unsigned int sim_tmr0_pre = 0;
+
+// CCP2 PWM, the X reference option (see vref.c)
+	static unsigned int sim_pwm2_duty = 0;	// Duty latched at the period start
+
+// CCP3 PWM
+	static int sim_pwm3 = 0;				// CCP3 output
+	static unsigned int sim_pwm3_duty = 0;	// Duty latched at the period start
+
+// EUSART
+	#define SIM_RX_QUEUE	4096
+	#define SIM_TX_QUEUE	4096
+
+	static unsigned char sim_rx_data[SIM_RX_QUEUE];		// Host chars on the way
+	static sim_cycles_t sim_rx_time[SIM_RX_QUEUE];		// When each one is in
+	static unsigned char sim_rx_ok[SIM_RX_QUEUE];		// Sent at the firmware rate
+	static unsigned int sim_rx_head = 0, sim_rx_tail = 0;
+	static sim_cycles_t sim_rx_last = 0;				// Last host char done
+
+	static unsigned char sim_rcfifo[2];		// Receive FIFO
+	static unsigned int sim_rcfifo_count = 0;
+
+	static unsigned char sim_txreg = 0;			// TXREG
+	static int sim_txreg_full = 0;
+	static unsigned char sim_txreg_latch = 0;	// Written through sim_txreg_write
+	static int sim_txreg_written = 0;
+	static unsigned char sim_tsr = 0;			// Shift register
+	static int sim_tsr_full = 0;
+	static sim_cycles_t sim_tsr_done = 0;
+
+	static unsigned char sim_tx_data[SIM_TX_QUEUE];		// Firmware chars for the host
+	static unsigned int sim_tx_head = 0, sim_tx_tail = 0;
+
+// Event frames (SER_EVENT) read off the line ahead of a reply
+	#define SIM_EVENTS		32
+	#define SIM_EVENT_MAX	16
+
+	static unsigned char sim_event_msg[SIM_EVENTS][SIM_EVENT_MAX];
+	static int sim_event_size[SIM_EVENTS];
+	static unsigned int sim_event_head = 0, sim_event_count = 0;
+
+	unsigned char sim_eeprom[SIM_EEPROM_SIZE] = { [0 ... SIM_EEPROM_SIZE - 1] = 0xFF };	// Erased
+	unsigned long sim_eeprom_writes = 0;
+	static sim_cycles_t sim_eeprom_ready = 0;	// Last write done
+
+// Interrupt flags as seen last cycle, and when they were set
+	static unsigned int sim_flags = 0;
+	static sim_cycles_t sim_flag_time[SIM_IRQ_COUNT];
+
+// The firmware baud rate in cycles per bit (see baud.c)
+unsigned int sim_uart_bit_cycles(void)
+{
+	unsigned int brg = ((unsigned int)SPBRGH << 8) | SPBRGL;
+
+	if(BRG16 && BRGH)
+		return brg + 1;
+	if(BRG16 || BRGH)
+		return 4 * (brg + 1);
+	return 16 * (brg + 1);
+}
+
+unsigned char sim_rcreg_read(void)
+{
+	unsigned char data = sim_rcfifo[0];
+
+	if(sim_rcfifo_count)
+	{
+		sim_rcfifo[0] = sim_rcfifo[1];
+		sim_rcfifo_count--;
+	}
+	RCIF = (sim_rcfifo_count != 0);
+	return data;
+}
+
+unsigned char *sim_txreg_write(void)
+{
+	sim_txreg_written = 1;	// Taken by sim_tx_commit
+	return &sim_txreg_latch;
+}
+
+static void sim_tx_commit(void)
+{
+	if(!sim_txreg_written)
+		return;
+
+	sim_txreg_written = 0;
+	if(sim_txreg_full)
+		sim_stats.tx_overwrites++;
+	sim_txreg = sim_txreg_latch;
+	sim_txreg_full = 1;
+	TXIF = 0;
+}
+
+static void sim_uart_cycle(void)
+{
+	unsigned int bit_cycles = sim_uart_bit_cycles();
+
+	// Host chars in
+	while(sim_rx_head != sim_rx_tail && sim_rx_time[sim_rx_head] <= sim_cycles)
+	{
+		if(SPEN && CREN)
+		{
+			if(!sim_rx_ok[sim_rx_head])
+				sim_stats.rx_framing++;
+			else if(sim_rcfifo_count < 2)
+				sim_rcfifo[sim_rcfifo_count++] = sim_rx_data[sim_rx_head];
+			else
+			{
+				OERR = 1;
+				sim_stats.rx_overruns++;
+			}
+		}
+		sim_rx_head = (sim_rx_head + 1) % SIM_RX_QUEUE;
+	}
+	RCIF = (sim_rcfifo_count != 0);
+
+	// Firmware chars out
+	if(sim_tsr_full && sim_cycles >= sim_tsr_done)
+	{
+		if((sim_tx_tail + 1) % SIM_TX_QUEUE != sim_tx_head)
+		{
+			sim_tx_data[sim_tx_tail] = sim_tsr;
+			sim_tx_tail = (sim_tx_tail + 1) % SIM_TX_QUEUE;
+		}
+		sim_stats.tx_chars++;
+		if(!sim_stats.tx_first)
+			sim_stats.tx_first = sim_cycles;
+		sim_tsr_full = 0;
+	}
+	if(sim_txreg_full && !sim_tsr_full)
+	{
+		sim_tsr = sim_txreg;
+		sim_tsr_full = 1;
+		sim_tsr_done = sim_cycles + 10 * bit_cycles;	// Start, 8 data, stop
+		sim_txreg_full = 0;
+	}
+	TXIF = !sim_txreg_full;
+	TRMT = !sim_tsr_full;
+}
+
+// One timer clock, returns 1 when the post-scaler sets TMRxIF
+static int sim_timer_cycle(sim_timer_t *t)
+{
+	static const unsigned int pre[4] = { 1, 4, 16, 64 };
+	unsigned char con = t->con->byte;
+
+	t->rolled = 0;
+
+	if(con != t->last_con)
+	{
+		t->pre = 0;
+		t->post = 0;
+		t->last_con = con;
+	}
+
+	if(!(con & 0x04))	// TMRxON
+		return 0;
+
+	if(++t->pre < pre[con & 0x03])
+		return 0;
+	t->pre = 0;
+
+	if(t->tmr->byte == t->pr->byte)
+	{
+		t->tmr->byte = 0;
+		t->rolled = 1;
+		if(++t->post > ((con >> 3) & 0x0F))
+		{
+			t->post = 0;
+			return 1;
+		}
+	}
+	else
+		t->tmr->byte++;
+
+	return 0;
+}
+
+static void sim_timers_cycle(void)
+{
+	// Timer0, FOSC/4 through the OPTION_REG pre-scaler
+	if(!TMR0CS)
+	{
+		unsigned int pre = PSA ? 1 : 2u << (OPTION_REG & 0x07);
+
+		if(++sim_tmr0_pre >= pre)
+		{
+			sim_tmr0_pre = 0;
+			if(++TMR0 == 0)
+				TMR0IF = 1;
+		}
+	}
+
+	if(sim_timer_cycle(&sim_timer[0]))
+		TMR2IF = 1;
+	if(sim_timer_cycle(&sim_timer[1]))
+		TMR4IF = 1;
+	if(sim_timer_cycle(&sim_timer[2]))
+		TMR6IF = 1;
+
+	// CCP2 PWM on RB3 from Timer2, only its duty matters (see vref.c)
+	if(((CCP2CON & 0x0C) == 0x0C) && CCP2SEL && ((CCPTMRS0 & 0x0C) == 0x00))
+	{
+		if(sim_timer[0].rolled)
+			sim_pwm2_duty = ((unsigned int)CCPR2L << 2) | ((CCP2CON >> 4) & 0x03);
+	}
+	else
+		sim_pwm2_duty = 0;
+
+	// CCP3 PWM on RB5 from Timer6 (see drive_pwm.c)
+	if(((CCP3CON & 0x0C) == 0x0C) && CCP3SEL && ((CCPTMRS0 & 0x30) == 0x20))
+	{
+		if(sim_timer[2].rolled)
+		{
+			sim_pwm3_duty = ((unsigned int)CCPR3L << 2) | ((CCP3CON >> 4) & 0x03);
+			sim_pwm3 = (sim_pwm3_duty != 0);
+		}
+		else if(((unsigned int)TMR6 << 2) >= sim_pwm3_duty)
+			sim_pwm3 = 0;
+	}
+	else
+		sim_pwm3 = 0;
+}
+
+// L297 VREF in Volts.  DACOUT is FVR (1.024 Volts) * DACR / 32.  With
+// CCP2 PWM on RB3 X takes the filtered PWM instead, VDD (5 Volts) *
+// duty, taken as an ideal filter of the last period.
+static double sim_vref(int axis)
+{
+	if(axis == 0 && ((CCP2CON & 0x0C) == 0x0C) && CCP2SEL)
+		return 5.0 * sim_pwm2_duty / (4.0 * (PR2 + 1));
+	if(DACCON0 & 0x80)
+		return 1.024 * (DACCON1 & 0x1F) / 32.0;
+	return 0.0;
+}
+
+// The fixture: STEP rising edges move an axis when its L297 is out
+// of RESET, the limit switches pull PORTC low.
+static void sim_axis_step(sim_axis_t *axis, int step, int dir, int reset, int half)
+{
+	if(step && !axis->step)
+	{
+		if(!reset)
+			axis->ignored++;
+		else
+		{
+			double ref = sim_vref(axis - sim_axis);
+
+			if(!axis->steps)
+			{
+				axis->first_step = sim_cycles;
+				axis->ref_min = axis->ref_max = ref;
+			}
+			if(ref < axis->ref_min)
+				axis->ref_min = ref;
+			if(ref > axis->ref_max)
+				axis->ref_max = ref;
+			axis->steps++;
+			axis->position += (dir ? 1 : -1) * (half ? 1 : 2);
+		}
+	}
+	axis->step = step;
+}
+
+static void sim_fixture_cycle(void)
+{
+	unsigned char limits = 0;
+	int z_step = ((CCP3CON & 0x0C) == 0x0C && CCP3SEL) ? sim_pwm3 : RB5;
+
+	sim_axis_step(&sim_axis[0], RB1, RB0, RA0, RB2);
+	sim_axis_step(&sim_axis[1], RA5, RA4, RA1, RA6);
+	sim_axis_step(&sim_axis[2], z_step, RB4, RA3, RB6);
+
+	for(int a = 0; a < 3; a++)
+	{
+		if(sim_axis[a].position <= 0)
+			limits |= 1 << (2 * a);			// HOME
+		if(sim_axis[a].position >= sim_axis[a].travel)
+			limits |= 2 << (2 * a);			// FFH
+	}
+
+	PORTC = (PORTC & 0xC0) | (~limits & 0x3F);	// Active low
+}
+
+// The interrupt flags with their enables
+static unsigned int sim_irq_pending(void)
+{
+	unsigned int pending = 0;
+
+	if(TMR0IF && TMR0IE) pending |= 1 << SIM_IRQ_TMR0;
+	if(PEIE)
+	{
+		if(TMR2IF && TMR2IE) pending |= 1 << SIM_IRQ_TMR2;
+		if(TMR4IF && TMR4IE) pending |= 1 << SIM_IRQ_TMR4;
+		if(TMR6IF && TMR6IE) pending |= 1 << SIM_IRQ_TMR6;
+		if(RCIF && RCIE) pending |= 1 << SIM_IRQ_RC;
+		if(TXIF && TXIE) pending |= 1 << SIM_IRQ_TX;
+	}
+	return pending;
+}
+
+static void sim_cycle(void)
+{
+	unsigned int pending;
+
+	sim_cycles++;
+	sim_stats.cycles++;
+
+	sim_timers_cycle();
+	sim_uart_cycle();
+	sim_fixture_cycle();
+
+	// Latency is counted from the cycle a flag (with its enable) is set
+	pending = sim_irq_pending();
+	for(int s = 0; s < SIM_IRQ_COUNT; s++)
+		if((pending & (1u << s)) && !(sim_flags & (1u << s)))
+			sim_flag_time[s] = sim_cycles;
+	sim_flags = pending;
+}
+
+static void sim_interrupt(void)
+{
+	unsigned int served = sim_flags;
+
+	for(int s = 0; s < SIM_IRQ_COUNT; s++)
+	{
+		if(served & (1u << s))
+		{
+			sim_cycles_t latency = sim_cycles - sim_flag_time[s];
+
+			sim_stats.irq_count[s]++;
+			sim_stats.irq_latency_sum[s] += latency;
+			if(latency > sim_stats.irq_latency_max[s])
+				sim_stats.irq_latency_max[s] = latency;
+		}
+	}
+
+	sim_stats.isr_entries++;
+
+	sim_in_isr = 1;
+	GIE = 0;
+	isr();
+	sim_tx_commit();
+	GIE = 1;	// RETFIE
+
+	for(unsigned int c = 0; c < sim_isr_cycles; c++)
+		sim_cycle();
+	sim_in_isr = 0;
+}
+
+// Called by the firmware wherever it waits (see HAL_IDLE in pic.h)
+// HI-TECH eeprom_write waits for the last write to finish (WR) with
+// the interrupts running, then starts this one
+unsigned char eeprom_read(unsigned char addr)
+{
+	return sim_eeprom[addr];
+}
+
+void eeprom_write(unsigned char addr, unsigned char value)
+{
+	while(sim_cycles < sim_eeprom_ready)
+		sim_idle();
+
+	sim_eeprom[addr] = value;
+	sim_eeprom_writes++;
+	sim_eeprom_ready = sim_cycles + SIM_EEPROM_WRITE_CYCLES;
+}
+
+void sim_idle(void)
+{
+	sim_tx_commit();
+
+	for(unsigned int c = 0; c < sim_idle_cycles; c++)
+	{
+		sim_cycle();
+		if(GIE && sim_flags && !sim_in_isr)
+			sim_interrupt();
+	}
+
+	// A main loop held up in a long job, only the interrupts run
+	while(sim_cycles < sim_stall_end && !sim_in_isr)
+	{
+		sim_cycle();
+		if(GIE && sim_flags)
+			sim_interrupt();
+	}
+
+	if(sim_cycles >= sim_stop_at)
+		swapcontext(&sim_fw_ctx, &sim_host_ctx);
+}
+
+static void sim_power_up(void)
+{
+	for(int a = 0; a < 3; a++)
+	{
+		sim_axis[a].steps = 0;
+		sim_axis[a].ignored = 0;
+		sim_axis[a].step = 0;
+		if(sim_axis[a].travel == 0)
+			sim_axis[a].travel = 20000;
+	}
+
+	// Power on reset values used by the firmware
+	TRISA = TRISB = TRISC = 0xFF;
+	ANSELA = ANSELB = 0xFF;
+	OPTION_REG = 0xFF;
+	T2CON = T4CON = T6CON = 0x00;
+	PR2 = PR4 = PR6 = 0xFF;
+	TXSTA = 0x02;	// TRMT
+	PIR1 = 0x10;	// TXIF
+	SPBRGL = 0x00;
+	SPBRGH = 0x00;
+
+	sim_fixture_cycle();
+}
+
+void sim_boot(void (*entry)(void))
+{
+	sim_power_up();
+	sim_stats_clear();
+
+	getcontext(&sim_fw_ctx);
+	sim_fw_ctx.uc_stack.ss_sp = sim_fw_stack;
+	sim_fw_ctx.uc_stack.ss_size = sizeof(sim_fw_stack);
+	sim_fw_ctx.uc_link = &sim_host_ctx;
+	makecontext(&sim_fw_ctx, entry, 0);
+
+	sim_run(0);
+}
+
+void sim_run(sim_cycles_t cycles)
+{
+	sim_stop_at = sim_cycles + cycles;
+	swapcontext(&sim_host_ctx, &sim_fw_ctx);
+}
+
+void sim_stall(sim_cycles_t cycles)
+{
+	sim_stall_end = sim_cycles + cycles;
+}
+
+int sim_run_until(int (*done)(void), sim_cycles_t timeout)
+{
+	sim_cycles_t end = sim_cycles + timeout;
+
+	while(!done())
+	{
+		if(sim_cycles >= end)
+			return 0;
+		sim_run(SIM_CYCLES_PER_MS / 4);
+	}
+	return 1;
+}
+
+void sim_stats_clear(void)
+{
+	sim_stats_t empty = { 0 };
+
+	sim_stats = empty;
+	for(int a = 0; a < 3; a++)
+	{
+		sim_axis[a].steps = 0;
+		sim_axis[a].ignored = 0;
+		sim_axis[a].first_step = 0;
+	}
+}
+
+void sim_uart_send(const unsigned char *data, unsigned int size)
+{
+	unsigned int bit_cycles = sim_host_bit_cycles ? sim_host_bit_cycles : sim_uart_bit_cycles();
+	unsigned int fw_cycles = sim_uart_bit_cycles();
+	int ok = (bit_cycles * 100 >= fw_cycles * 97) && (bit_cycles * 100 <= fw_cycles * 103);
+
+	if(sim_rx_last < sim_cycles)
+		sim_rx_last = sim_cycles;
+
+	for(unsigned int a = 0; a < size; a++)
+	{
+		unsigned int next = (sim_rx_tail + 1) % SIM_RX_QUEUE;
+
+		if(next == sim_rx_head)
+		{
+			fprintf(stderr, "sim: host transmit queue full\n");
+			exit(2);
+		}
+
+		sim_rx_last += 10 * bit_cycles;	// Start, 8 data, stop
+		sim_rx_data[sim_rx_tail] = data[a];
+		sim_rx_time[sim_rx_tail] = sim_rx_last;
+		sim_rx_ok[sim_rx_tail] = ok;
+		sim_rx_tail = next;
+	}
+}
+
+// CRC-8 (0x07) of the frame size and message (see crc8 in ser.c)
+static unsigned char sim_crc8(unsigned char crc, unsigned char data)
+{
+	crc ^= data;
+	for(int b = 0; b < 8; b++)
+		crc = (crc & 0x80) ? (unsigned char)((crc << 1) ^ 0x07) : (unsigned char)(crc << 1);
+	return crc;
+}
+
+void sim_send_frame(const unsigned char *msg, unsigned int size)
+{
+	unsigned char frame[2 + 256 + 1];
+	unsigned char crc = sim_crc8(0x00, (unsigned char)size);
+
+	frame[0] = 0x7E;	// SER_SOF
+	frame[1] = (unsigned char)size;
+	for(unsigned int a = 0; a < size; a++)
+	{
+		frame[2 + a] = msg[a];
+		crc = sim_crc8(crc, msg[a]);
+	}
+	frame[2 + size] = crc;
+
+	sim_uart_send(frame, size + 3);
+}
+
+sim_cycles_t sim_uart_sent_at(void)
+{
+	return sim_rx_last;
+}
+
+unsigned int sim_uart_sending(void)
+{
+	return (sim_rx_tail + SIM_RX_QUEUE - sim_rx_head) % SIM_RX_QUEUE;
+}
+
+unsigned int sim_uart_received(void)
+{
+	return (sim_tx_tail + SIM_TX_QUEUE - sim_tx_head) % SIM_TX_QUEUE;
+}
+
+static unsigned char sim_tx_peek(unsigned int offset)
+{
+	return sim_tx_data[(sim_tx_head + offset) % SIM_TX_QUEUE];
+}
+
+// Anything before SER_SOF or SER_EVENT is thrown away, as the firmware
+// does.  1 if a frame starts at the head.
+static int sim_tx_skip(void)
+{
+	while(sim_uart_received() && sim_tx_peek(0) != 0x7E && sim_tx_peek(0) != 0x7D)
+		sim_tx_head = (sim_tx_head + 1) % SIM_TX_QUEUE;
+
+	return sim_uart_received() != 0;
+}
+
+// The frame at the head: its size once all in, -1 not yet, -2 bad CRC-8
+static int sim_tx_frame(unsigned char *msg, unsigned int max)
+{
+	unsigned int size;
+	unsigned char crc;
+
+	if(sim_uart_received() < 2)
+		return -1;
+	size = sim_tx_peek(1);
+	if(sim_uart_received() < size + 3)
+		return -1;
+
+	crc = sim_crc8(0x00, (unsigned char)size);
+	for(unsigned int a = 0; a < size; a++)
+	{
+		if(a < max)
+			msg[a] = sim_tx_peek(2 + a);
+		crc = sim_crc8(crc, sim_tx_peek(2 + a));
+	}
+	crc ^= sim_tx_peek(2 + size);
+	sim_tx_head = (sim_tx_head + size + 3) % SIM_TX_QUEUE;
+
+	return crc ? -2 : (int)size;
+}
+
+// Event frames at the head are kept for sim_recv_event.  1 if a reply
+// frame is next.
+static int sim_tx_events(void)
+{
+	while(sim_tx_skip() && sim_tx_peek(0) == 0x7D)
+	{
+		unsigned int slot = (sim_event_head + sim_event_count) % SIM_EVENTS;
+		int size = sim_tx_frame(sim_event_msg[slot], SIM_EVENT_MAX);
+
+		if(size == -1)
+			return 0;
+		if(sim_event_count == SIM_EVENTS)
+		{
+			fprintf(stderr, "sim: event queue full\n");
+			exit(2);
+		}
+		sim_event_size[slot] = size;
+		sim_event_count++;
+	}
+
+	return sim_uart_received() != 0;
+}
+
+int sim_recv_frame(unsigned char *msg, unsigned int max)
+{
+	if(!sim_tx_events())
+		return -1;
+	return sim_tx_frame(msg, max);
+}
+
+int sim_recv_event(unsigned char *msg, unsigned int max)
+{
+	int size;
+
+	sim_tx_events();
+	if(!sim_event_count)
+		return -1;
+
+	size = sim_event_size[sim_event_head];
+	for(int a = 0; a < size && a < (int)max && a < SIM_EVENT_MAX; a++)
+		msg[a] = sim_event_msg[sim_event_head][a];
+	sim_event_head = (sim_event_head + 1) % SIM_EVENTS;
+	sim_event_count--;
+
+	return size;
+}
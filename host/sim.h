@@ -0,0 +1,105 @@
+/*
+ * sim.h (host build)
+ *
+ * Simulated PIC16F1933 and fixture used to run the firmware on the
+ * host.  Time is counted in instruction cycles (FOSC/4, 125 nSec).
+ * The timers, EUSART, CCP2/CCP3 PWM, DACOUT and the three L297 drives with their
+ * limit switches are modelled, the firmware runs in its own context
+ * and only lets simulated time pass at HAL_IDLE() (see pic.h).
+ *
+*/
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+	#define SIM_CYCLES_PER_SEC	8000000ULL	// 32 MHz FOSC / 4
+	#define SIM_CYCLES_PER_MS	8000ULL
+
+	typedef unsigned long long sim_cycles_t;
+
+// Interrupt sources the isr serves
+	enum
+	{
+		SIM_IRQ_TMR0 = 0,	// 1 mSec tick
+		SIM_IRQ_TMR2,		// X step (or XYZ)
+		SIM_IRQ_TMR4,		// Y step
+		SIM_IRQ_TMR6,		// Z step
+		SIM_IRQ_RC,			// Serial receive
+		SIM_IRQ_TX,			// Serial transmit
+		SIM_IRQ_COUNT
+	};
+
+	extern const char *sim_irq_name[SIM_IRQ_COUNT];
+
+// A stepper axis of the fixture.  The position is in L297 half
+// steps from the HOME switch, a full step moves it 2.  The HOME switch
+// is made at 0 or below and the far from home (FFH) switch at travel
+// or above.
+	typedef struct
+	{
+		long position;			// Half steps from HOME
+		long travel;			// Half steps from HOME to FFH
+		unsigned long steps;	// STEP rising edges taken by the L297
+		unsigned long ignored;	// STEP rising edges while in RESET
+		sim_cycles_t first_step;	// Cycle of the first step taken (0 none, see sim_stats_clear)
+		double ref_min, ref_max;	// L297 VREF (Volts) seen at the steps taken
+		unsigned char step;		// STEP line seen last cycle
+	} sim_axis_t;
+
+	extern sim_axis_t sim_axis[3];	// X, Y, Z
+
+// Data EEPROM (see eeprom_write in sim.c).  It keeps its contents
+// over sim_boot like the PIC's over a power cycle.
+	#define SIM_EEPROM_SIZE				256
+	#define SIM_EEPROM_WRITE_CYCLES		(4 * SIM_CYCLES_PER_MS)	// Per byte
+
+	extern unsigned char sim_eeprom[SIM_EEPROM_SIZE];
+	extern unsigned long sim_eeprom_writes;		// Bytes written
+
+// Counts kept while the firmware runs (see sim_stats_clear)
+	typedef struct
+	{
+		sim_cycles_t cycles;						// Cycles counted
+		unsigned long isr_entries;					// isr calls
+		unsigned long irq_count[SIM_IRQ_COUNT];		// Interrupts served per source
+		sim_cycles_t irq_latency_sum[SIM_IRQ_COUNT];	// Flag set to isr entry, summed
+		sim_cycles_t irq_latency_max[SIM_IRQ_COUNT];	// Flag set to isr entry, worst
+		unsigned long rx_overruns;					// Chars lost, receive FIFO full
+		unsigned long rx_framing;					// Chars sent at the wrong baud rate
+		unsigned long tx_overwrites;				// TXREG written while full
+		unsigned long tx_chars;						// Chars transmitted
+		sim_cycles_t tx_first;						// Cycle the first char was out (0 none)
+	} sim_stats_t;
+
+	extern sim_stats_t sim_stats;
+	extern sim_cycles_t sim_cycles;		// Cycles since sim_boot
+
+// Timing.  Code between HAL_IDLE() calls takes no simulated time,
+// each HAL_IDLE() pass takes sim_idle_cycles and each isr call
+// sim_isr_cycles, whatever it runs.  These only keep the main loop and
+// the interrupts from being free, they are not the cycles of the PIC
+// build and no isr cost or load is worked out from them.  They can be
+// set from the command line of xyz_bench (see bench.c).
+	extern unsigned int sim_idle_cycles;
+	extern unsigned int sim_isr_cycles;
+
+// Host side of the serial line.  sim_host_bit_cycles is the host
+// baud rate in cycles per bit, 0 follows the firmware rate.
+	extern unsigned int sim_host_bit_cycles;
+
+	extern void sim_boot(void (*entry)(void));	// Power up and run the firmware to its first HAL_IDLE
+	extern void sim_run(sim_cycles_t cycles);	// Let the firmware run for cycles
+	extern int sim_run_until(int (*done)(void), sim_cycles_t timeout);	// 1 if done() before timeout
+	extern void sim_stall(sim_cycles_t cycles);	// Hold the firmware main loop at its next HAL_IDLE for cycles
+	extern void sim_stats_clear(void);
+
+	extern unsigned int sim_uart_bit_cycles(void);	// Firmware baud rate in cycles per bit
+	extern void sim_uart_send(const unsigned char *data, unsigned int size);	// Host to firmware chars
+	extern void sim_send_frame(const unsigned char *msg, unsigned int size);	// Host to firmware frame
+	extern int sim_recv_frame(unsigned char *msg, unsigned int max);	// Next firmware reply frame size, -1 none, -2 bad
+	extern int sim_recv_event(unsigned char *msg, unsigned int max);	// Next firmware event frame size, -1 none, -2 bad
+	extern unsigned int sim_uart_sending(void);		// Host to firmware chars still on the way
+	extern sim_cycles_t sim_uart_sent_at(void);		// Cycle the last host char is (was) in
+	extern unsigned int sim_uart_received(void);	// Firmware to host chars not read yet
+
+#endif
@@ -0,0 +1,653 @@
+/*
+ * sim_main.c (host build)
+ *
+ * Regression run of the firmware on the simulated fixture (see sim.c).
+ * The commands go in over the simulated serial line the same way the
+ * host software sends them and the fixture axes are checked against
+ * the positions the firmware reports.  Exits non-zero on a failure.
+ *
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../globals.h"
+#include "proto.h"
+
+	extern void fw_main(void);	// main() of main.c (see Makefile)
+
+	static int failures = 0;
+	static long home_at[3];		// Fixture position where the firmware set 0
+
+static void check(int ok, const char *test, const char *what)
+{
+	if(!ok)
+	{
+		printf("FAIL %s: %s\n", test, what);
+		failures++;
+	}
+}
+
+static void command(const char *msg, unsigned int size)
+{
+	if(!proto_command(msg, size))
+	{
+		printf("FAIL command %.*s not taken\n", (int)size, msg);
+		failures++;
+	}
+}
+
+// The fixture has to be where the firmware says it is
+static void check_axes(const char *test)
+{
+	static const char name[3] = { 'X', 'Y', 'Z' };
+	volatile unsigned short *location[3] = { &X_location, &Y_location, &Z_location };
+	char what[80];
+
+	for(int a = 0; a < 3; a++)
+	{
+		long moved = sim_axis[a].position - home_at[a];
+
+		snprintf(what, sizeof(what), "%c fixture at %ld, firmware at %u",
+				name[a], moved, *location[a]);
+		check(moved == (long)*location[a], test, what);
+
+		snprintf(what, sizeof(what), "%c read back", name[a]);
+		check(proto_read_position(name[a]) == (long)*location[a], test, what);
+	}
+}
+
+static void report(const char *test, sim_cycles_t start)
+{
+	unsigned long steps = sim_axis[0].steps + sim_axis[1].steps + sim_axis[2].steps;
+	unsigned long step_irqs = sim_stats.irq_count[SIM_IRQ_TMR2]
+							+ sim_stats.irq_count[SIM_IRQ_TMR4]
+							+ sim_stats.irq_count[SIM_IRQ_TMR6];
+
+	printf("%s %s: %.1f ms, %lu steps, %lu step interrupts (%.2f per step), "
+			"worst step latency %.1f us\n",
+			failures ? "...." : "PASS", test,
+			(double)(sim_cycles - start) / SIM_CYCLES_PER_MS, steps, step_irqs,
+			steps ? (double)step_irqs / steps : 0.0,
+			(double)(sim_stats.irq_latency_max[SIM_IRQ_TMR2] > sim_stats.irq_latency_max[SIM_IRQ_TMR6]
+				? sim_stats.irq_latency_max[SIM_IRQ_TMR2] : sim_stats.irq_latency_max[SIM_IRQ_TMR6])
+				* 1000.0 / SIM_CYCLES_PER_MS);
+}
+
+static void run_move(const char *test, const char *msg, unsigned int size, sim_cycles_t timeout)
+{
+	sim_cycles_t start = sim_cycles;
+
+	sim_stats_clear();
+	command(msg, size);
+	check(sim_run_until(proto_motion_idle, timeout), test, "move did not finish");
+	report(test, start);
+	check_axes(test);
+}
+
+static void test_initialize(void)
+{
+	unsigned char version[8] = { 0 };
+	sim_cycles_t start = sim_cycles;
+
+	sim_stats_clear();
+	command("I", 1);
+	check(proto_reply(version, 7, 20 * SIM_CYCLES_PER_SEC) == 7, "initialize", "no version reply");
+	check(version[0] == 'X' && version[6] == '0', "initialize", "wrong version reply");
+	report("initialize", start);
+
+	for(int a = 0; a < 3; a++)
+	{
+		check(sim_axis[a].position <= 0, "initialize", "not on the HOME switch");
+		home_at[a] = sim_axis[a].position;
+	}
+	check_axes("initialize");
+}
+
+// FULL step traverse with the last 100 half steps in HALF step.  Each
+// axis out an odd number of half steps and back, the fixture has to end
+// up where the firmware says with about half the STEP pulses.
+static void test_full_step(void)
+{
+	volatile unsigned short *location[3] = { &X_location, &Y_location, &Z_location };
+
+	for(int a = 0; a < 3; a++)
+	{
+		char msg[5] = { 'W', 'N', "XYZ"[a], 0x00, 0x64 };
+
+		command(msg, 5);
+		for(int m = 0; m < 2; m++)
+		{
+			unsigned int to = m ? *location[a] - 2501 : *location[a] + 2501;
+			char test[16];
+
+			snprintf(test, sizeof(test), "full_step_%c", "xyz"[a]);
+			msg[0] = 'S', msg[1] = 'N', msg[3] = (char)(to >> 8), msg[4] = (char)to;
+			run_move(test, msg, 5, 20 * SIM_CYCLES_PER_SEC);
+			check(sim_axis[a].steps < 1400, test, "not FULL step");
+		}
+		msg[0] = 'W', msg[1] = 'N', msg[3] = msg[4] = 0x00;
+		command(msg, 5);
+	}
+}
+
+// Z on the S-curve ramp, 8 half steps per table entry (512 to full
+// speed).  A long move out and a short one back that turns around on
+// the curve, both have to end back down at Z_min_speed.
+static void test_scurve(void)
+{
+	command("WCZ\x08", 4);
+
+	run_move("scurve_z", "SNZ\x07\xD0", 5, 20 * SIM_CYCLES_PER_SEC);		// Z to 2000
+	check(Z_speed == Z_min_speed, "scurve_z", "not back to Z_min_speed");
+	run_move("scurve_z_short", "SNZ\x06\xA4", 5, 20 * SIM_CYCLES_PER_SEC);	// Z to 1700
+	check(Z_speed == Z_min_speed, "scurve_z_short", "not back to Z_min_speed");
+
+	command("WCZ\x00", 4);
+}
+
+// A drive on to a limit switch stops at the step that made it and
+// 'RH' reports the switch and the location it was hit at.  Y alone
+// and then X in an XYZ move, with FFH moved in 1000 half steps.
+static void test_limit(void)
+{
+	static const char *msg[2] = { "SNY\xFF\xFF", "SNA\xFF\xFF\x00\x00\x00\x00" };
+	static const char *test[2] = { "limit_y", "limit_xyz" };
+	static const unsigned char hit[2] = { 0x08, 0x02 };
+	static const int axis[2] = { 1, 0 };
+	volatile unsigned short *location[3] = { &X_location, &Y_location, &Z_location };
+
+	for(int t = 0; t < 2; t++)
+	{
+		int a = axis[t];
+		unsigned char data[13];
+
+		sim_axis[a].travel = sim_axis[a].position + 1000;
+		run_move(test[t], msg[t], t ? 9 : 5, 20 * SIM_CYCLES_PER_SEC);
+
+		check(sim_axis[a].position == sim_axis[a].travel, test[t], "not stopped at the switch");
+		check(proto_command("RH", 2) && proto_reply(data, 13, SIM_CYCLES_PER_SEC) == 13, test[t], "no 'RH' reply");
+		check(data[0] == hit[t], test[t], "wrong switch hit");
+		check(proto_location(&data[1 + 4 * a]) == *location[a], test[t], "wrong hit location");
+
+		sim_axis[a].travel = 20000;
+	}
+	command("CL", 2);
+}
+
+// Time drives were held waiting on Vref, 'RVT'
+static long vref_wait(void)
+{
+	unsigned char data[4];
+
+	if(!proto_command("RVT", 3) || proto_reply(data, 4, SIM_CYCLES_PER_SEC) != 4)
+		return -1;
+	return ((long)data[0] << 24) | ((long)data[1] << 16) | ((long)data[2] << 8) | data[3];
+}
+
+// X and Z use different Vrefs, so each move switches DACOUT.  With a
+// 30 mSec settle only 20 of it is left after the RESET/Enable delay.
+static void test_vref_settle(void)
+{
+	long before, after;
+
+	command("WTX\x00\x1E", 5);	// X settle 30 mSec
+	command("WTZ\x00\x1E", 5);	// Z settle 30 mSec
+	before = vref_wait();
+
+	run_move("vref_settle_x", "SNX\x01\x90", 5, 10 * SIM_CYCLES_PER_SEC);	// X to 400
+	run_move("vref_settle_z", "SNZ\x00\xC8", 5, 10 * SIM_CYCLES_PER_SEC);	// Z to 200
+
+	after = vref_wait();
+	check(before >= 0 && after - before >= 2 * (30 - DRIVE_RESET_MS) - 4
+			&& after - before <= 2 * (30 - DRIVE_RESET_MS) + 4, "vref_settle", "wrong Vref wait");
+	printf("%s vref_settle: %ld ms held waiting on Vref\n", failures ? "...." : "PASS", after - before);
+
+	command("WTX\x00\xFA", 5);	// Back to 250 mSec
+	command("WTZ\x00\xFA", 5);
+}
+
+// Reference seen by an axis over its last move, within 4% of Volts
+static void check_ref(const char *test, int a, double volts)
+{
+	char what[80];
+
+	snprintf(what, sizeof(what), "%c VREF %.3f to %.3f V, not %.3f V",
+			"XYZ"[a], sim_axis[a].ref_min, sim_axis[a].ref_max, volts);
+	check(sim_axis[a].steps && sim_axis[a].ref_min > volts * 0.96 && sim_axis[a].ref_max < volts * 1.04,
+			test, what);
+}
+
+// X on its own CCP2 reference runs at X_vref in an XYZ move while Y and
+// Z share DACOUT, and moving Y after X does not change DACOUT.
+static void test_vref_pwm(void)
+{
+	long before;
+
+	command("WRX\x01", 4);	// X reference from CCP2
+	command("WVY\x08", 4);	// Y below X, above Z
+
+	run_move("vref_pwm_xyz", "SNA\x03\x20\x01\x2C\x00\x96", 9, 10 * SIM_CYCLES_PER_SEC);	// 800, 300, 150
+	check_ref("vref_pwm_xyz", 0, 1.024 * 0x11 / 32);	// X_vref
+	check_ref("vref_pwm_xyz", 1, 1.024 * 0x08 / 32);	// Y_vref, the larger of Y and Z
+	check_ref("vref_pwm_xyz", 2, 1.024 * 0x08 / 32);
+
+	run_move("vref_pwm_x", "SNX\x01\x2C", 5, 10 * SIM_CYCLES_PER_SEC);	// X to 300
+	check_ref("vref_pwm_x", 0, 1.024 * 0x11 / 32);
+
+	before = vref_wait();
+	run_move("vref_pwm_y", "SNY\x00\x64", 5, 10 * SIM_CYCLES_PER_SEC);	// Y to 100
+	check(vref_wait() == before, "vref_pwm_y", "waited on Vref");
+
+	command("WRX\x00", 4);
+	command("WVY\x11", 4);
+}
+
+// One char reply of a command, -1 none
+static int reply_char(const char *msg, unsigned int size)
+{
+	unsigned char data[1];
+
+	if(!proto_command(msg, size) || proto_reply(data, 1, SIM_CYCLES_PER_SEC) != 1)
+		return -1;
+	return data[0];
+}
+
+// Settings saved with 'NW' are loaded at power up (EE_LOAD, called
+// here as main() would), and not after 'NE'.  'NW' is refused while a
+// move is running and while a new baud rate waits for 'BC'.  'NI' after
+// 'NP' takes the parked position with the RAM locations lost and no
+// steps, after a move it is 'I' again.
+static void test_eeprom(void)
+{
+	unsigned char version[7];
+	sim_cycles_t start;
+
+	command("WFX\x0B\xB8", 5);	// X_max_speed 3000
+	check(reply_char("NW", 2) > 0, "eeprom_settings", "nothing written");
+	check(reply_char("NW", 2) == 0, "eeprom_settings", "written again");
+	command("SNX\x01\x2C", 5);	// X to 300
+	check(reply_char("NW", 2) == 0xFF, "eeprom_settings", "written while moving");
+	check(sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC), "eeprom_settings", "move did not finish");
+	check_axes("eeprom_settings");
+	check(reply_char("BS\x01", 3) == 1, "eeprom_settings", "baud not set");
+	sim_run(SIM_CYCLES_PER_MS);	// New rate once the reply is out (see write_baud)
+	check(reply_char("NW", 2) == 0xFF, "eeprom_settings", "written before 'BC'");
+	check(reply_char("BC", 2) == 1, "eeprom_settings", "baud not confirmed");
+	check(proto_baud(0), "eeprom_settings", "baud not back to 19200");
+	command("WFX\x07\xD0", 5);	// Back to 2000
+	EE_LOAD();
+	check(X_max_speed == 3000, "eeprom_settings", "not loaded");
+	command("NE", 2);
+	command("WFX\x07\xD0", 5);
+	EE_LOAD();
+	check(X_max_speed == 2000, "eeprom_settings", "loaded after 'NE'");
+
+	run_move("eeprom_park", "SNA\x02\xBC\x02\x58\x01\xF4", 9, 10 * SIM_CYCLES_PER_SEC);	// 700, 600, 500
+	check(reply_char("NP", 2) == 1, "eeprom_park", "not parked");
+	X_location = Y_location = Z_location = 0;	// RAM lost over the power cycle
+
+	start = sim_cycles;
+	sim_stats_clear();
+	command("NI", 2);
+	check(proto_reply(version, 7, SIM_CYCLES_PER_SEC) == 7, "eeprom_park", "no version reply");
+	report("eeprom_park_ni", start);
+	check(sim_axis[0].steps + sim_axis[1].steps + sim_axis[2].steps == 0, "eeprom_park", "moved");
+	check_axes("eeprom_park");
+
+	run_move("eeprom_unpark", "SNX\x01\x90", 5, 10 * SIM_CYCLES_PER_SEC);	// X to 400
+	check(sim_eeprom[EE_PARK] != EE_MARK, "eeprom_unpark", "still parked");
+	command("NI", 2);
+	check(proto_reply(version, 7, 20 * SIM_CYCLES_PER_SEC) == 7, "eeprom_unpark", "no version reply");
+	check(X_location == 0 && Y_location == 0 && Z_location == 0, "eeprom_unpark", "not HOME");
+	check_axes("eeprom_unpark");
+}
+
+// 'RA' in the middle of an XYZ move has the running bits and each axis
+// between where it started and its new location, once idle the same as
+// the single reads.
+static void test_read_all(void)
+{
+	unsigned char data[30];
+	long at;
+
+	command("SNA\x01\xF4\x01\xF4\x01\xF4", 9);	// 500, 500, 500
+	sim_run(400 * SIM_CYCLES_PER_MS);
+	check(proto_command("RA", 2) && proto_reply(data, 30, SIM_CYCLES_PER_SEC) == 30, "read_all", "no 'RA' reply");
+	check((data[24] & 0x70) == 0x70, "read_all", "not running");
+	for(int a = 0; a < 3; a++)
+	{
+		at = proto_location(&data[4 * a]);
+		check(at > 0 && at < 500, "read_all", "location not on the way");
+		check(proto_location(&data[12 + 4 * a]) == 500, "read_all", "wrong new location");
+	}
+	check(data[28] == MOTION_DRIVE_XYZ, "read_all", "wrong motion_job");
+
+	run_move("read_all", "SNX\x00\xC8", 5, 10 * SIM_CYCLES_PER_SEC);	// then X to 200
+	check(proto_command("RA", 2) && proto_reply(data, 30, SIM_CYCLES_PER_SEC) == 30, "read_all", "no 'RA' reply");
+	check(proto_location(&data[0]) == proto_read_position('X') && proto_location(&data[4]) == proto_read_position('Y')
+			&& proto_location(&data[8]) == proto_read_position('Z'), "read_all", "not the same as 'RP'");
+	check(data[24] == system_status && data[25] == (unsigned char)~PORTC && data[26] == limit_status
+			&& data[27] == working_vref && data[28] == MOTION_IDLE && data[29] == 0, "read_all", "wrong status");
+}
+
+// 'REX', -1 no reply (can't be told from -1, not used)
+static long read_x_long(void)
+{
+	unsigned char data[4];
+
+	if(!proto_command("REX", 3) || proto_reply(data, 4, SIM_CYCLES_PER_SEC) != 4)
+		return -1;
+	return proto_location(data);
+}
+
+// Wide (4 char) locations carry into the high word going up past 0xFFFF
+// and borrow going down past 0, with the fixture moving the same half
+// steps.  A move over 0xFFFF half steps is refused.
+static void test_wide(void)
+{
+	long start = sim_axis[0].position;
+	unsigned int was = X_location;
+	char msg[5] = { 'W', 'P', 'X', 0, 0 };
+
+	command("WPX\x00\x00\xFF\x9C", 7);	// X at 65436
+	command("SNX\x00\x01\x00\x64", 7);	// X to 65636
+	check(sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC), "wide_carry", "move did not finish");
+	check(sim_axis[0].position - start == 200, "wide_carry", "fixture moved wrong");
+	check(read_x_long() == 65636 && proto_read_position('X') == 100, "wide_carry", "wrong location");
+
+	command("WPX\x00\x00\x00\x64", 7);	// X at 100
+	command("SNX\xFF\xFF\xFF\x38", 7);	// X to -200
+	check(sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC), "wide_borrow", "move did not finish");
+	check(sim_axis[0].position - start == -100, "wide_borrow", "fixture moved wrong");
+	check(read_x_long() == -200 && proto_read_position('X') == 0xFF38, "wide_borrow", "wrong location");
+
+	command("SNX\x00\x04\x00\x00", 7);	// X to 262144, too far
+	check(sim_run_until(proto_motion_idle, SIM_CYCLES_PER_SEC), "wide_too_far", "move did not finish");
+	check(sim_axis[0].position - start == -100 && (system_status & 0x03) == 0x03, "wide_too_far", "not refused");
+	command("CS", 2);
+
+	// Queued moves are kept as half steps from the one before (see
+	// MOTION_ADD in motion.c), the 32 bit locations have to come out
+	// as sent
+	command("WPX\x00\x00\xFF\x9C", 7);	// X at 65436
+	command("SNX\x00\x01\x00\x64", 7);	// X to 65636
+	command("SNX\x00\x01\x01\x2C", 7);	// X to 65836
+	command("SNX\x00\x04\x00\x00", 7);	// X to 262144, too far from 65836
+	command("SNX\x00\x01\x00\x00", 7);	// X to 65536
+	check((system_status & 0x03) == 0x03, "wide_queue", "too far not refused");
+	check(sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC), "wide_queue", "moves did not finish");
+	check(sim_axis[0].position - start == 0, "wide_queue", "fixture moved wrong");
+	check(read_x_long() == 65536, "wide_queue", "wrong location");
+	command("CS", 2);
+	command("WPX\xFF\xFF\xFF\x9C", 7);	// X at -100
+	command("SNX\xFF\xFF\xFF\x38", 7);	// X back to -200
+	check(sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC), "wide_queue", "move back did not finish");
+
+	msg[3] = (unsigned char)((was - 100) >> 8);	// Back where the fixture is
+	msg[4] = (unsigned char)(was - 100);
+	command(msg, 5);
+	check(read_x_long() == (long)was - 100, "wide_short", "'WPX' not back to 16 bit");
+	printf("%s wide: carry, borrow, too far and queued\n", failures ? "...." : "PASS");
+}
+
+// An XYZ move over 32767 half steps.  The DDA error terms are 16 bit
+// (see XYZ_STEP in drive_xyz.c), X_err + X_delta would not fit and an
+// axis would lose its steps.  Out and back, every half step has to be
+// taken.
+static void test_xyz_long(void)
+{
+	static const long out[3] = { 45000, 33000, 0 };
+	volatile unsigned short *location[3] = { &X_location, &Y_location, &Z_location };
+	volatile short *location_hi[3] = { &X_location_hi, &Y_location_hi, &Z_location_hi };
+	long from[3], start[3];
+	char msg[15] = { 'S', 'N', 'A' };
+
+	for(int back = 0; back < 2; back++)
+	{
+		for(int a = 0; a < 3; a++)
+		{
+			long to;
+
+			if(!back)
+			{
+				from[a] = POSITION(*location_hi[a], *location[a]);
+				sim_axis[a].travel = sim_axis[a].position + out[a] + 100;
+			}
+			start[a] = sim_axis[a].position;
+			to = back ? from[a] : from[a] + out[a];
+			msg[3 + 4 * a] = (char)(to >> 24);
+			msg[4 + 4 * a] = (char)(to >> 16);
+			msg[5 + 4 * a] = (char)(to >> 8);
+			msg[6 + 4 * a] = (char)to;
+		}
+
+		run_move(back ? "xyz_long_back" : "xyz_long", msg, 15, 120 * SIM_CYCLES_PER_SEC);
+		for(int a = 0; a < 3; a++)
+			check(sim_axis[a].position - start[a] == (back ? -out[a] : out[a]),
+					back ? "xyz_long_back" : "xyz_long", "steps lost");
+	}
+
+	for(int a = 0; a < 3; a++)
+		sim_axis[a].travel = 20000;
+}
+
+// Next event frame is axis at location for reason, no errors
+static void check_event(const char *test, char axis, long location, unsigned char reason)
+{
+	unsigned char data[7];
+
+	check(proto_event(data, 7, 20 * SIM_CYCLES_PER_MS) == 7, test, "no event");
+	check(data[0] == axis && proto_location(&data[1]) == location, test, "wrong axis or location");
+	check(data[5] == reason, test, "wrong reason");
+	check(data[6] == 0x00, test, "error in event");
+}
+
+// With 'WE' each axis of a move sends an event frame as it ends: at the
+// new location, stopped by a switch or aborted, then each axis of 'SHA'.
+// A switch 65536 half steps past the target has the same low word but
+// is not the target (AXIS_EVENT called here as MOTION_EVENT would).
+static void test_events(void)
+{
+	unsigned char data[7];
+
+	command("WE\x01", 3);
+	run_move("event_reached", "SNX\x01\x2C", 5, 10 * SIM_CYCLES_PER_SEC);	// X to 300
+	check_event("event_reached", 'X', 300, EVENT_REACHED);
+	check(proto_event(data, 7, 20 * SIM_CYCLES_PER_MS) == -1, "event_reached", "more than one event");
+
+	sim_axis[1].travel = sim_axis[1].position + 200;
+	run_move("event_limit", "SNY\x0F\xA0", 5, 10 * SIM_CYCLES_PER_SEC);	// Y to 4000
+	check_event("event_limit", 'Y', Y_location, EVENT_LIMIT);
+	sim_axis[1].travel = 20000;
+	command("CL", 2);
+
+	command("SNZ\x0F\xA0", 5);	// Z to 4000
+	sim_run(300 * SIM_CYCLES_PER_MS);
+	run_move("event_aborted", "AZ", 2, SIM_CYCLES_PER_SEC);
+	check_event("event_aborted", 'Z', Z_location, EVENT_ABORTED);
+
+	run_move("event_home", "SHA", 3, 60 * SIM_CYCLES_PER_SEC);
+	check_event("event_home", 'X', 0, EVENT_REACHED);
+	check_event("event_home", 'Y', 0, EVENT_REACHED);
+	check_event("event_home", 'Z', 0, EVENT_REACHED);
+
+	AXIS_EVENT('X', 65536 + 300, 300, 0x02);
+	check_event("event_wide", 'X', 65536 + 300, EVENT_LIMIT);
+	command("WE\x00", 3);
+}
+
+// 'SHA' from far out, all axes together and then Z first.  The slow
+// approach has to stop each axis on the same fixture position as the
+// first HOME.
+static void test_home(void)
+{
+	static const char *order[2] = { "WHO\x00", "WHO\x01" };
+	static const char *test[2] = { "home_xyz", "home_z_first" };
+
+	for(int o = 0; o < 2; o++)
+	{
+		command(order[o], 4);
+		command("SNA\x17\x70\x13\x88\x0B\xB8", 9);	// 6000, 5000, 3000
+		check(sim_run_until(proto_motion_idle, 60 * SIM_CYCLES_PER_SEC), test[o], "move out did not finish");
+		run_move(test[o], "SHA", 3, 60 * SIM_CYCLES_PER_SEC);
+	}
+	command("WHO\x00", 4);
+}
+
+static int x_running(void)
+{
+	return (system_status & 0x10) == 0x10;
+}
+
+// A HOME cut short keeps the real location: 'SHX' from 2000, aborted
+// during the seek, has to leave X where the fixture is.
+static void test_home_abort(void)
+{
+	command("SNX\x07\xD0", 5);	// 2000
+	check(sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC), "home_abort", "move out did not finish");
+	command("SHX", 3);
+	sim_run(300 * SIM_CYCLES_PER_MS);
+	check(x_running(), "home_abort", "X not seeking");
+	command("AX", 2);
+	check(sim_run_until(proto_motion_idle, SIM_CYCLES_PER_SEC), "home_abort", "abort did not finish");
+	check(X_location_hi == 0 && X_location > 0 && X_location < 2000, "home_abort", "X location lost");
+	check_axes("home_abort");
+}
+
+// A drive has to stop at its new location in the step interrupt, the
+// main loop may not get to AXIS_DRIVE_DONE until long after (here it is
+// held up for a second as soon as X is running).
+static void test_stall(void)
+{
+	unsigned short to = X_location + 300;
+	char msg[5] = { 'S', 'N', 'X', (char)(to >> 8), (char)to };
+
+	command(msg, 5);
+	check(sim_run_until(x_running, SIM_CYCLES_PER_SEC), "stall", "X did not start");
+	sim_stall(SIM_CYCLES_PER_SEC);
+	check(sim_run_until(proto_motion_idle, 10 * SIM_CYCLES_PER_SEC), "stall", "move did not finish");
+	check(X_location == to, "stall", "X not stopped at its new location");
+	check(limit_hit == 0x00, "stall", "X ran on to a switch");
+	check_axes("stall");
+}
+
+// The settings commands go through axes[] (see axis.c): 'WF' of each
+// axis has to land in that axis' max_speed and leave the others alone.
+static void test_axes(void)
+{
+	char msg[5] = { 'W', 'F', 0, 0x12, 0x34 };
+	unsigned int saved[AXIS_COUNT];
+
+	for(int a = 0; a < AXIS_COUNT; a++)
+		saved[a] = *axes[a].max_speed;
+
+	for(int a = 0; a < AXIS_COUNT; a++)
+	{
+		msg[2] = axes[a].name;
+		command(msg, 5);
+		for(int b = 0; b < AXIS_COUNT; b++)
+			check(*axes[b].max_speed == (b <= a ? 0x1234 : saved[b]), "axes", "wrong max_speed");
+	}
+
+	for(int a = 0; a < AXIS_COUNT; a++)
+		*axes[a].max_speed = saved[a];
+}
+
+// Each bad frame has to set the invalid command bits of system_status
+// and nothing else (see Execute in ser.c), good ones none.
+static void test_commands(void)
+{
+	static const struct
+	{
+		const char *msg;
+		unsigned int size;
+		int bad;
+	} frames[] = {
+		{ "Q", 1, 1 },					// No such command
+		{ "AQ", 2, 1 },					// No such axis
+		{ "SNX\x00", 4, 1 },			// Short
+		{ "SNA\x00\x00\x00\x00", 7, 1 },	// Neither 9 nor 15
+		{ "WRY\x01", 4, 1 },			// No Y handler
+		{ "WFX\x01", 4, 1 },			// 1 argument char of 2
+		{ "ZZ", 2, 1 },					// No such first char
+		{ "RVQ", 3, 1 },
+		{ "AX", 2, 0 },
+		{ "RVT", 3, 0 },
+		{ "WE\x00", 3, 0 },
+	};
+	unsigned char data[2];
+	char what[40];
+
+	for(unsigned int f = 0; f < sizeof(frames) / sizeof(frames[0]); f++)
+	{
+		command(frames[f].msg, frames[f].size);
+		proto_reply(data, 2, 10 * SIM_CYCLES_PER_MS);	// Drop any reply
+		snprintf(what, sizeof(what), "%.*s status", (int)frames[f].size, frames[f].msg);
+		check(reply_char("RS", 2) == (frames[f].bad ? 0x03 : 0x00), "commands", what);
+		command("CS", 2);
+	}
+
+	// A frame in while main() has not run the last one is dropped and
+	// the last one is run as it came in (see isr in main.c)
+	unsigned int x_speed = X_max_speed;
+	unsigned int y_speed = Y_max_speed;
+
+	sim_stall(20 * SIM_CYCLES_PER_MS);
+	sim_send_frame((const unsigned char *)"WFX\x12\x34", 5);
+	sim_send_frame((const unsigned char *)"WFY\x56\x78", 5);
+	sim_run(30 * SIM_CYCLES_PER_MS);
+	check(X_max_speed == 0x1234, "commands", "first frame not run");
+	check(Y_max_speed == y_speed, "commands", "second frame run");
+	check(reply_char("RS", 2) == 0x03, "commands", "second frame not dropped");
+	command("CS", 2);
+	X_max_speed = x_speed;
+}
+
+int main(void)
+{
+	// Fixture left somewhere off HOME
+	sim_axis[0].position = 400;
+	sim_axis[1].position = 300;
+	sim_axis[2].position = 200;
+
+	sim_boot(fw_main);
+
+	test_initialize();
+
+	run_move("drive_x", "SNX\x03\xE8", 5, 10 * SIM_CYCLES_PER_SEC);			// X to 1000
+	run_move("drive_y", "SNY\x02\x00", 5, 10 * SIM_CYCLES_PER_SEC);			// Y to 512
+	run_move("drive_z", "SNZ\x01\x2C", 5, 10 * SIM_CYCLES_PER_SEC);			// Z to 300
+	run_move("drive_xyz", "SNA\x02\x58\x01\xF4\x00\x64", 9, 10 * SIM_CYCLES_PER_SEC);	// 600, 500, 100
+
+	command("WMZ\x01", 4);	// Z STEP from CCP3
+	run_move("drive_z_pwm", "SNZ\x05\xDC", 5, 10 * SIM_CYCLES_PER_SEC);		// Z to 1500
+	command("WMZ\x00", 4);
+
+	// Back to back moves go through the motion queue
+	command("SNX\x00\xC8", 5);	// X to 200
+	command("SNY\x03\x20", 5);	// Y to 800
+	run_move("queue", "SNZ\x00\x32", 5, 20 * SIM_CYCLES_PER_SEC);			// Z to 50
+
+	test_full_step();
+	test_scurve();
+	test_vref_settle();
+	test_vref_pwm();
+	test_limit();
+	test_eeprom();
+	test_events();
+	test_read_all();
+	test_wide();
+	test_xyz_long();
+	test_stall();
+	test_axes();
+	test_commands();
+	test_home_abort();
+	test_home();
+
+	check(system_status == 0x00, "status", "system error set");
+
+	printf("%s: %d failure%s\n", failures ? "FAILED" : "PASSED", failures, failures == 1 ? "" : "s");
+	return failures ? 1 : 0;
+}
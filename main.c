@@ -1,257 +1,388 @@
-/*
- * main.c
- *
- * This is the main entry point to the code.  It contains the main
- * function definition as well as the service interrupt routines.
+/*
+ * main.c
+ *
+ * This is the main entry point to the code.  It contains the main
+ * function definition as well as the service interrupt routines.
  * 
-*/
-
-#include "globals.h";
-
-	volatile unsigned gbl_ms_Timer = 0;	// Used when Pre-Scaler value of '0b100' equals 1:32.  With a FOCS of
-										// 32 mHz, the Timer0 Flag will be set every 1.024 mSec when started
-										// at 0x00.  Starting the timer at 0x06 resolves this offset issue
-										// resulting in an interrupt every 1 mSec.
-										// 1.024 = (1/(32M/4))* ( 256: TIMER0 is 8 bit) * (Pre-Scale: 32)
-
-	volatile bit ms_Timer_flag = 0;		// mSec Timer flag used by the timer 0 interrupt to detirmine
-										// which global timer gets updated.
-									
-	volatile int index = 0;			// Receiver 'rxfifo' index
-	volatile int RX_Size = 0;		// Receiver number of chars in message (first char in every receive)
-
-// This is configuration word 1 (defaults used for config 2).  They are defined in pic16lf1933.h and
-// are used to configure the chip upon power up.
-
-__CONFIG(FCMEN_OFF & MCLRE_OFF & BOREN_OFF & CPD_OFF & CP_OFF & CLKOUTEN_OFF & IESO_OFF & PWRTE_OFF & WDTE_OFF & FOSC_INTOSC & LVP_ON & PLLEN_ON);
-
-// This is the interrupt service routine (isr). The transmitter receive
-// interrupt will always be active but others may be enabled or disabled
-// based on the functions using them.  An in-line or macro definition can
-// be used to speed up the execution time but is not used do to the slow
-// execution speeds required by this design.  Besides, this is easier to
-// read if you don't actually have much programming and embedded controller
-// experience.  This PIC only has one interrupt vector so priorities do
-// not have to be set up.  When the interrupt occurs, a flag is set.  This
-// interrupt forces the FW to jump to this interrupt vector.  The flags are
-// reviewed to detirmine what needs to be done.
-void interrupt isr(void)
-{
-	/**** This is the RX Interrupt flag ***/
-	if(RCIF)
-	{	
-		// If an error occured, reset to clear it
-		if(OERR) 
-		{	
-			CREN = 0;
-			CREN = 1;
-		}
-		// The first value received will contain the number
-		// of chars in the message
-		if( index == 0)
-			RX_Size = (int)RCREG;
-	
-		// Capture the second Char to the message size in the
-		// rxfifo buffer
-		if(index > 0 && index <= RX_Size)
-			rxfifo[index-1] = RCREG;
-		
-		index++;
-		// If we got all the chars, reset the index for the next
-		// RX Interrupt and execute the command we received	
-		if(index > RX_Size)
-		{
-			index = 0;
-			Execute();  // (see ser.c)
-		}	
-	}
-	/**** End of this is the RX Interrupt flag ***/
-	
-	if( TMR0IF && ms_Timer_flag) // Delay for Vref (see vref.c)
-	{	
-		TMR0 = 0x06;	// offset the timer to make the interrupt 1 mSec
-		gbl_ms_Timer++; // everytime here equals 1 mSec so capture it
-		TMR0IF = 0;		// reset this timer interrupt flag		
-	}	
-
-	if(TMR2IF)	// X Step Interrupt
-	{	
-		if(RB1)	// if drive High
-		{
-			if(RB0)	// X DIR Clockwise
-				X_location++; // if moving away from home
-			else
-				X_location--; // if moving towards home
-				
-			RB1 = 0;	// Drive STEP low
-		}
-		else
-			RB1 = 1;	// Drive STEP High
-				
-		TMR2 = 0x00;	// Clear X drive Timer
-		TMR2IF = 0;		// Clear interrupt flag
-	}
-	
-	if(TMR4IF)// Y Step Interrupt
-	{	
-		if(RA5)	// if drive High
-		{
-			if(RA4) // Y DIR Clockwise
-				Y_location++; // if moving away from home
-			else
-				Y_location--; // if moving towards home
-				
-			RA5 = 0;	// Drive STEP Low
-		}
-		else
-			RA5 = 1;	// Drive STEP High
-			
-		TMR4 = 0x00;	// Clear Y drive Timer
-		TMR4IF = 0;		// Clear interrupt flag
-	}				
-
-	if(TMR6IF)// Z Step Interrupt
-	{	
-		if(RB5)	// if drive High
-		{
-			if(RB4)	// Z DIR Clockwise
-				Z_location++; // if moving away from home
-			else
-				Z_location--; // if moving towards home
-				
-			RB5 = 0;	// Drive STEP low
-		}
-		else
-			RB5 = 1;	// Drive STEP High
-			
-		TMR6 = 0x00;	// Clear Y drive Timer
-		TMR6IF = 0;		// Clear interrupt flag
-	}			
-}	// End interrupt service routine (isr)
-
-// This is the starting point of this code upon power-up.  When the device
-// is turned on, the registers will be configured or setup for serial 
-// communication and the device inputs and outputs will be configured. After 
-// the device has been initialized this function will simply execute doing nothing 
-// but wait for an interrupt from the receiver.  This code does nothing unless it 
-// is told to by way of a receiver interrupt.
-void main(void)
-{
-// This following will setup everything needed for the serial interface.
-// and the inputs and outputs.  If parameters are changed from these starting 
-// values by functions executing within this code structure they should be reset 
-// by that function before exiting the call.
-
-	// This sets the internal clock frequency.  Much of this was done using
-	// configuration word 1&2 (see __CONFIG in above)
-	OSCCON = 0xF0;		// 32mHz internal clock
-						// The FOSC bits in Configuration Word 1 must be
-						// set to use the INTOSC source as the device
-						// system clock (FOSC<2:0> = 100).
-						// The IRCF bits in the OSCCON register must be
-						// set to the 8 MHz HFINTOSC selection
-						// (IRCF<3:0> = 1110).
-						// The SPLLEN bit in the OSCCON register must be
-						// set to enable the 4xPLL, or the PLLEN bit of the
-						// Configuration Word 2 must be programmed to a
-						// 1'
-
-	// The following will set up the communications (TX and RX) rate.  This
-	// is setting the prescale factors.  The rate is relative to the FOSC.
-	SPBRG = 0x19;		// baud rate = ~19200 (19231)
-						// SYNC = 0, BRGH = 0, BRG16 = 0
-						// calc baud rate err ~-0.16% for 19200
-						// If an error occurs it will show up as
-						// timeout (usually). 	
-	
-	RCSTA = 0b10110000;	// SPEN RX9 SREN CREN ADDEN FERR OERR RX9D
-						// SPEN will enable the EUSART and the TX/CK pin is automatically made an 
-						// output. Since the PIN maybe used for some analog function, it must be 
-						// disabled by clearing the corresponding bit of the ANSEL register
-						
-	TXSTA = 0b00100000;	//	TRANSMIT STATUS AND CONTROL REGISTER
-						//	CSRC TX9 TXEN SYNC SENDB BRGH TRMT TX9D
-	
-	BAUDCON = 0b0000000;// ABDOVF RCIDL  SCKP BRG16  WUE ABDEN
-	
-	// This sets the fixed voltage reference for the DACOUT (see vref.c)
-	FVRCON = 0b10000100;// FVRCON: FIXED VOLTAGE REFERENCE CONTROL REGISTER
-						// FVREN FVRRDY Reserved Reserved CDAFVR1 CDAFVR0 ADFVR1 ADFVR0
-						// FVRRDY is a status flag but will always read as set
-						// ADFVR1 ADFVR0 set the ref to 1x or 1.024 volts
-
-	// These configure ports that will be used for limit switches & communications...
-	//  RC0 = X-H		(digital input)
-	//  RC1 = X-FFH		(digital input)
-	//  RC2 = Y-H		(digital input)
-	//  RC3 = Y-FFH		(digital input)
-	//  RC4 = Y-H		(digital input)
-	//  RC5 = Y-FFH		(digital input)
-	//	RC6 = Tx		(digital output)
-	//	RC7 = Rx		(digital input)
-	
-	PORTC = 0b00000000;	// Power up values are okay.  Init Port: RC0 to RC7
-	
-	TRISC = 0b10111111; 	// TRISA: PORTA TRI-STATE REGISTER
-							// TRISA7 TRISA6 TRISA5 TRISA4 TRISA3 TRISA2 TRISA1 TRISA0
-							// bit set = input bit cleared = output
-
-	// These configure ports that will be digital outputs for X & Z Drive...
-	//	RB0 = X Drive DIR 			(digital output)
-	//	RB1 = X Drive STEP 			(digital output)
-	//	RB2 = X Drive HALF/FULL 	(digital output)
-	//	RB3 = X Drive PHASE/INH1,2 	(digital output)
-	//
-	//	RB4 = Z Drive DIR 			(digital output)
-	//	RB5 = Z Drive STEP 			(digital output)
-	//	RB6 = Z Drive HALF/FULL 	(digital output)
-	//	RB7 = Z Drive PHASE/INH1,2 	(digital output)
-	
-	PORTB = 0b00000000;	// Power up values are okay.  Init Port: RB0, RB1, RB2, RB3...
-	
-	TRISB = 0b00000000; 	// TRISB: PORTB TRI-STATE REGISTER
-							// TRISB7 TRISB6 TRISB5 TRISB4 TRISB3 TRISB2 TRISB1 TRISB0
-							// bit set = input bit cleared = output
-
-	ANSELB = 0b00000000;	// ANSELB: PORTB ANALOG SELECT REGISTER
-							//   ANSB5 ANSB4 ANSB3 ANSB2 ANSB1 ANSB0
-							// bit set = Analog bit cleared = digital
-
-	// These configure ports that will be used for XYZ Drive Mode & control...
-	//	RA0 = X Drive RESET			(digital output)
-	//	RA1 = Y Drive RESET 		(digital output)
-	//	RA2 = DAQOUT VREF	 		(analog output)
-	//	RA3 = Z Drive RESET 		(digital output)
-	//	RA4 = Z Drive DIR 			(digital output)
-	//	RA5 = Z Drive STEP 			(digital output)
-	//	RA6 = Z Drive HALF/FULL 	(digital output)
-	//	RA7 = Z Drive PHASE/INH1,2 	(digital output)
-	
-	PORTA = 0b00000000;		// Power up values are okay.  Init Port: RA0, RA1, RA2...
-	
-	TRISA = 0b00000000; 	// TRISA: PORTA TRI-STATE REGISTER
-							// TRISA7(1) TRISA6(1) TRISA5 TRISA4 TRISA3 TRISA2 TRISA1 TRISA0
-							// bit set = input bit cleared = output
-
-	ANSELA = 0b00000100;	// ANSELA: PORTA ANALOG SELECT REGISTER
-							//   ANSA5 ANSA4 ANSA3 ANSA2 ANSA1 ANSA0
-							// bit set = Analog bit cleared = digital
-
-	OPTION_REG = 0b10000100;		// WPUEN INTEDG TMR0CS TMR0SE PSA PS<2:0>
-									// PSA cleared to assign a prescaler
-									// PS<2:0> of 0x100 sets the prescaler to 1:32
-									// And the Timer mode is selected by clearing the
-									// TMR0CS bit of the OPTION register (FOSC/4).
-
-	// This enables the interrupts (also contains some flags)
-	INTCON = 0b11000000;// GIE PEIE TMR0IE INTE IOCIE TMR0IF INTF IOCIF
-	PIE1 = 0b00100000;	// TMR1GIE ADIE RCIE TXIE SSP1IE CCP1IE TMR2IE TMR1IE
-	
-	SET_TIMERS();	// Set drive Timer scale (see drive_timer.c)
-
-	while(1)	
-	{
-	  /* Do nothing but wait for a receiver interrupt */
-	}
-
-}
+*/
+
+#include "globals.h"
+
+	volatile unsigned gbl_ms_Timer = 0;	// Used when Pre-Scaler value of '0b100' equals 1:32.  With a FOCS of
+										// 32 mHz, the Timer0 Flag will be set every 1.024 mSec when started
+										// at 0x00.  Starting the timer at 0x06 resolves this offset issue
+										// resulting in an interrupt every 1 mSec.
+										// 1.024 = (1/(32M/4))* ( 256: TIMER0 is 8 bit) * (Pre-Scale: 32)
+
+	volatile bit ms_Timer_flag = 0;		// mSec Timer flag used by the timer 0 interrupt to detirmine
+										// which global timer gets updated.
+									
+	volatile unsigned char index = 0;	// Receiver frame index (0 = waiting for SER_SOF)
+	volatile unsigned char RX_Size = 0;	// Receiver number of chars in the message in rxfifo
+	volatile unsigned char rx_crc = 0;		// Received CRC-8 of the message in rxfifo
+	volatile bit rx_ready = 0;		// A complete message is in rxfifo for Execute (see main)
+	volatile bit rx_drop = 0;		// Frame came in before Execute was done with rxfifo
+	volatile unsigned char rx_length = 0;	// Receiver number of chars in the message being captured
+	volatile unsigned char rx_idle_ms = 0;	// mSec since the last char of a message being captured
+
+// This is configuration word 1 (defaults used for config 2).  They are defined in pic16lf1933.h and
+// are used to configure the chip upon power up.
+
+__CONFIG(FCMEN_OFF & MCLRE_OFF & BOREN_OFF & CPD_OFF & CP_OFF & CLKOUTEN_OFF & IESO_OFF & PWRTE_OFF & WDTE_OFF & FOSC_INTOSC & LVP_ON & PLLEN_ON);
+
+// This is the interrupt service routine (isr). The transmitter receive
+// interrupt will always be active but others may be enabled or disabled
+// based on the functions using them.  An in-line or macro definition can
+// be used to speed up the execution time but is not used do to the slow
+// execution speeds required by this design.  Besides, this is easier to
+// read if you don't actually have much programming and embedded controller
+// experience.  This PIC only has one interrupt vector so priorities do
+// not have to be set up.  When the interrupt occurs, a flag is set.  This
+// interrupt forces the FW to jump to this interrupt vector.  The flags are
+// reviewed to detirmine what needs to be done.
+void interrupt isr(void)
+{
+	unsigned char rx_data;	// Char received
+	unsigned char half_steps;	// Half steps of a STEP (2 in FULL step, see drive_mode.c)
+
+	/**** This is the RX Interrupt flag ***/
+	if(RCIF)
+	{	
+		// If an error occured, reset to clear it
+		if(OERR) 
+		{	
+			CREN = 0;
+			CREN = 1;
+		}
+
+		// Every message is framed (see Execute in ser.c):
+		//   SER_SOF, size, size chars of message, CRC-8
+		// Anything but SER_SOF is thrown away while waiting for a
+		// frame so a dropped or extra char only costs one message.
+		rx_data = RCREG;
+		rx_idle_ms = 0;	// (see Timer0 below)
+
+		if( index == 0)
+		{
+			if(rx_data == SER_SOF)
+				index = 1;
+		}
+		else if( index == 1)	// The message size
+		{
+			if(rx_data == 0 || rx_data > SER_BUFFER_SIZE)
+			{
+				index = 0;	// Can't be a good frame, wait for the next SER_SOF
+				system_status |= 0x03; 	// Invalid command
+										// Error
+			}
+			else
+			{
+				rx_length = rx_data;
+				rx_drop = rx_ready;	// main() is still on the last one
+				index = 2;
+			}
+		}
+		else if( index < rx_length + 2)	// The message
+		{
+			if(!rx_drop)
+				rxfifo[index-2] = rx_data;	// Captured in place
+			index++;
+		}
+		else	// The CRC-8
+		{
+			// We got all the chars, reset the index for the next
+			// frame and hand the command we received to main().
+			// If main() had not taken the last one when this one
+			// started, rxfifo was left alone and this one is lost.
+			index = 0;
+			if(!rx_drop)
+			{
+				RX_Size = rx_length;
+				rx_crc = rx_data;	// Checked by Execute (see ser.c)
+				rx_ready = 1;		// Execute in main() (see ser.c)
+			}
+			else
+				system_status |= 0x03; 	// Invalid command
+										// Error
+		}
+	}
+	/**** End of this is the RX Interrupt flag ***/
+
+	/**** This is the TX Interrupt flag (see SendByte in ser.c) ***/
+	if(TXIE && TXIF)
+	{
+		TXREG = txring[tx_head];	// The transmission of the Start bit, 
+									// data bits and Stop bit sequence commences 
+									// immediately following the transfer of the 
+									// data to the TSR from the TXREG.
+		tx_head = (tx_head + 1) & (TX_RING_SIZE - 1);
+
+		if(tx_head == tx_tail)
+			TXIE = 0;	// Ring empty, TXIF stays set until the next SendByte
+	}
+	/**** End of this is the TX Interrupt flag ***/
+	
+	if( TMR0IF) // 1 mSec tick, always running
+	{	
+		TMR0 = 0x06;	// offset the timer to make the interrupt 1 mSec
+
+		if(ms_Timer_flag)	// Delay for settle (see msDelay in drive_timer.c)
+			gbl_ms_Timer++; // everytime here equals 1 mSec so capture it
+
+		// DACOUT settling after a new Vref (see vref.c)
+		if(vref_settle_ms && --vref_settle_ms == 0)
+			vref_ready = 1;
+
+		// Drives waiting on RESET/Enable and Vref (see drive_start.c)
+		if(drive_starting)
+			DRIVE_GO();
+
+		// A frame stopped part way (lost char), start over with
+		// the next SER_SOF (see RX above)
+		if(index && ++rx_idle_ms >= RX_TIMEOUT_MS)
+			index = 0;
+
+		// Host has to confirm a new baud rate in time (see baud.c)
+		if(baud_confirm_ms && --baud_confirm_ms == 0)
+			baud_timeout = 1;
+
+		TMR0IF = 0;		// reset this timer interrupt flag		
+	}	
+
+	if(TMR2IE && TMR2IF)	// X Step Interrupt (Timer2 also runs the X reference PWM, see vref.c)
+	{	
+		if(xyz_mode)	// X Timer is stepping XYZ together
+			XYZ_STEP();	// (see drive_xyz.c)
+		else if(RB1)	// if drive High
+		{
+			half_steps = RB2 ? 1 : 2;	// X_location is in half steps
+			if(RB0)	// X DIR Clockwise
+			{
+				X_location += half_steps; // if moving away from home
+				if(!(X_location >> 8) && (unsigned char)X_location < half_steps)
+					X_location_hi++;	// Carry, rare (see drive_start.c)
+			}
+			else
+			{
+				if(!(X_location >> 8) && (unsigned char)X_location < half_steps)
+					X_location_hi--;	// Borrow, rare (see drive_start.c)
+				X_location -= half_steps; // if moving towards home
+			}
+			location_seq++;	// (see LOCATION in drive_start.c)
+
+			if(ramp_on & 0x10)
+				X_RAMP();	// Update speed (see drive_ramp.c)
+				
+			RB1 = 0;	// Drive STEP low
+		}
+		else if(!X_LIMIT())	// Stops X at a switch ahead (see system_status.c)
+			RB1 = 1;	// Drive STEP High
+				
+		if(!X_vref_pwm)	// Timer2 clears itself, CCP2 needs whole periods
+			TMR2 = 0x00;	// Clear X drive Timer
+		TMR2IF = 0;		// Clear interrupt flag
+	}
+	
+	if(TMR4IF)// Y Step Interrupt
+	{	
+		if(RA5)	// if drive High
+		{
+			half_steps = RA6 ? 1 : 2;	// Y_location is in half steps
+			if(RA4) // Y DIR Clockwise
+			{
+				Y_location += half_steps; // if moving away from home
+				if(!(Y_location >> 8) && (unsigned char)Y_location < half_steps)
+					Y_location_hi++;	// Carry, rare (see drive_start.c)
+			}
+			else
+			{
+				if(!(Y_location >> 8) && (unsigned char)Y_location < half_steps)
+					Y_location_hi--;	// Borrow, rare (see drive_start.c)
+				Y_location -= half_steps; // if moving towards home
+			}
+			location_seq++;	// (see LOCATION in drive_start.c)
+
+			if(ramp_on & 0x20)
+				Y_RAMP();	// Update speed (see drive_ramp.c)
+				
+			RA5 = 0;	// Drive STEP Low
+		}
+		else if(!Y_LIMIT())	// Stops Y at a switch ahead (see system_status.c)
+			RA5 = 1;	// Drive STEP High
+			
+		TMR4 = 0x00;	// Clear Y drive Timer
+		TMR4IF = 0;		// Clear interrupt flag
+	}				
+
+	if(TMR6IF)// Z Step Interrupt
+	{	
+		if(Z_pwm_on)	// CCP3 drives STEP, one interrupt per step
+			Z_PWM_STEP();	// (see drive_pwm.c)
+		else if(RB5)	// if drive High
+		{
+			half_steps = RB6 ? 1 : 2;	// Z_location is in half steps
+			if(RB4)	// Z DIR Clockwise
+			{
+				Z_location += half_steps; // if moving away from home
+				if(!(Z_location >> 8) && (unsigned char)Z_location < half_steps)
+					Z_location_hi++;	// Carry, rare (see drive_start.c)
+			}
+			else
+			{
+				if(!(Z_location >> 8) && (unsigned char)Z_location < half_steps)
+					Z_location_hi--;	// Borrow, rare (see drive_start.c)
+				Z_location -= half_steps; // if moving towards home
+			}
+			location_seq++;	// (see LOCATION in drive_start.c)
+
+			if(ramp_on & 0x40)
+				Z_RAMP();	// Update speed (see drive_ramp.c)
+				
+			RB5 = 0;	// Drive STEP low
+		}
+		else if(!Z_LIMIT())	// Stops Z at a switch ahead (see system_status.c)
+			RB5 = 1;	// Drive STEP High
+			
+		if(!Z_pwm_on)		// The PWM period runs on from the match
+			TMR6 = 0x00;	// Clear Y drive Timer
+		TMR6IF = 0;		// Clear interrupt flag
+	}			
+}	// End interrupt service routine (isr)
+
+// This is the starting point of this code upon power-up.  When the device
+// is turned on, the registers will be configured or setup for serial 
+// communication and the device inputs and outputs will be configured. After 
+// the device has been initialized this function will wait for the receiver
+// interrupt to flag a complete message (rx_ready) and execute it.  Moves are
+// started by Execute and polled here until they are done (see motion.c).
+void main(void)
+{
+// This following will setup everything needed for the serial interface.
+// and the inputs and outputs.  If parameters are changed from these starting 
+// values by functions executing within this code structure they should be reset 
+// by that function before exiting the call.
+
+	// This sets the internal clock frequency.  Much of this was done using
+	// configuration word 1&2 (see __CONFIG in above)
+	OSCCON = 0xF0;		// 32mHz internal clock
+						// The FOSC bits in Configuration Word 1 must be
+						// set to use the INTOSC source as the device
+						// system clock (FOSC<2:0> = 100).
+						// The IRCF bits in the OSCCON register must be
+						// set to the 8 MHz HFINTOSC selection
+						// (IRCF<3:0> = 1110).
+						// The SPLLEN bit in the OSCCON register must be
+						// set to enable the 4xPLL, or the PLLEN bit of the
+						// Configuration Word 2 must be programmed to a
+						// 1'
+
+	// The following will set up the communications (TX and RX) rate.  This
+	// is setting the prescale factors.  The rate is relative to the FOSC.
+	RCSTA = 0b10110000;	// SPEN RX9 SREN CREN ADDEN FERR OERR RX9D
+						// SPEN will enable the EUSART and the TX/CK pin is automatically made an 
+						// output. Since the PIN maybe used for some analog function, it must be 
+						// disabled by clearing the corresponding bit of the ANSEL register
+						
+	TXSTA = 0b00100000;	//	TRANSMIT STATUS AND CONTROL REGISTER
+						//	CSRC TX9 TXEN SYNC SENDB BRGH TRMT TX9D
+	
+	BAUDCON = 0b0000000;// ABDOVF RCIDL  SCKP BRG16  WUE ABDEN
+
+	SET_BAUD(0);		// baud rate = ~19200 (19185)
+						// SYNC = 0, BRGH = 1, BRG16 = 1 (see baud.c)
+						// calc baud rate err ~-0.08% for 19200
+						// If an error occurs it will show up as
+						// timeout (usually). 	
+	
+	// This sets the fixed voltage reference for the DACOUT (see vref.c)
+	FVRCON = 0b10000100;// FVRCON: FIXED VOLTAGE REFERENCE CONTROL REGISTER
+						// FVREN FVRRDY Reserved Reserved CDAFVR1 CDAFVR0 ADFVR1 ADFVR0
+						// FVRRDY is a status flag but will always read as set
+						// ADFVR1 ADFVR0 set the ref to 1x or 1.024 volts
+
+	// These configure ports that will be used for limit switches & communications...
+	//  RC0 = X-H		(digital input)
+	//  RC1 = X-FFH		(digital input)
+	//  RC2 = Y-H		(digital input)
+	//  RC3 = Y-FFH		(digital input)
+	//  RC4 = Y-H		(digital input)
+	//  RC5 = Y-FFH		(digital input)
+	//	RC6 = Tx		(digital output)
+	//	RC7 = Rx		(digital input)
+	
+	PORTC = 0b00000000;	// Power up values are okay.  Init Port: RC0 to RC7
+	
+	TRISC = 0b10111111; 	// TRISA: PORTA TRI-STATE REGISTER
+							// TRISA7 TRISA6 TRISA5 TRISA4 TRISA3 TRISA2 TRISA1 TRISA0
+							// bit set = input bit cleared = output
+
+	// These configure ports that will be digital outputs for X & Z Drive...
+	//	RB0 = X Drive DIR 			(digital output)
+	//	RB1 = X Drive STEP 			(digital output)
+	//	RB2 = X Drive HALF/FULL 	(digital output)
+	//	RB3 = X Drive PHASE/INH1,2 	(digital output)
+	//
+	//	RB4 = Z Drive DIR 			(digital output)
+	//	RB5 = Z Drive STEP 			(digital output)
+	//	RB6 = Z Drive HALF/FULL 	(digital output)
+	//	RB7 = Z Drive PHASE/INH1,2 	(digital output)
+	
+	PORTB = 0b00000000;	// Power up values are okay.  Init Port: RB0, RB1, RB2, RB3...
+	
+	TRISB = 0b00000000; 	// TRISB: PORTB TRI-STATE REGISTER
+							// TRISB7 TRISB6 TRISB5 TRISB4 TRISB3 TRISB2 TRISB1 TRISB0
+							// bit set = input bit cleared = output
+
+	ANSELB = 0b00000000;	// ANSELB: PORTB ANALOG SELECT REGISTER
+							//   ANSB5 ANSB4 ANSB3 ANSB2 ANSB1 ANSB0
+							// bit set = Analog bit cleared = digital
+
+	// These configure ports that will be used for XYZ Drive Mode & control...
+	//	RA0 = X Drive RESET			(digital output)
+	//	RA1 = Y Drive RESET 		(digital output)
+	//	RA2 = DAQOUT VREF	 		(analog output)
+	//	RA3 = Z Drive RESET 		(digital output)
+	//	RA4 = Z Drive DIR 			(digital output)
+	//	RA5 = Z Drive STEP 			(digital output)
+	//	RA6 = Z Drive HALF/FULL 	(digital output)
+	//	RA7 = Z Drive PHASE/INH1,2 	(digital output)
+	
+	PORTA = 0b00000000;		// Power up values are okay.  Init Port: RA0, RA1, RA2...
+	
+	TRISA = 0b00000000; 	// TRISA: PORTA TRI-STATE REGISTER
+							// TRISA7(1) TRISA6(1) TRISA5 TRISA4 TRISA3 TRISA2 TRISA1 TRISA0
+							// bit set = input bit cleared = output
+
+	ANSELA = 0b00000100;	// ANSELA: PORTA ANALOG SELECT REGISTER
+							//   ANSA5 ANSA4 ANSA3 ANSA2 ANSA1 ANSA0
+							// bit set = Analog bit cleared = digital
+
+	OPTION_REG = 0b10000100;		// WPUEN INTEDG TMR0CS TMR0SE PSA PS<2:0>
+									// PSA cleared to assign a prescaler
+									// PS<2:0> of 0x100 sets the prescaler to 1:32
+									// And the Timer mode is selected by clearing the
+									// TMR0CS bit of the OPTION register (FOSC/4).
+
+	// This enables the interrupts (also contains some flags)
+	INTCON = 0b11100000;// GIE PEIE TMR0IE INTE IOCIE TMR0IF INTF IOCIF
+						// TMR0IE stays on for the 1 mSec tick (RX timeout and msDelay)
+	PIE1 = 0b00100000;	// TMR1GIE ADIE RCIE TXIE SSP1IE CCP1IE TMR2IE TMR1IE
+	
+	SET_TIMERS();	// Set drive Timer scale (see drive_timer.c)
+	EE_LOAD();		// Saved settings (see eeprom.c)
+
+	while(1)	
+	{
+		if(rx_ready)	// Message captured by the receiver interrupt
+		{
+			Execute();		// (see ser.c)
+			rx_ready = 0;	// rxfifo free for the next message
+		}
+
+		MOTION_SERVICE();	// Poll moves (see motion.c)
+		BAUD_SERVICE();		// Fall back to 19200 if not confirmed (see baud.c)
+
+		HAL_IDLE();	// (see globals.h)
+	}
+
+}
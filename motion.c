@@ -0,0 +1,318 @@
+/*
+ * motion.c
+ *
+ * Main loop motion scheduler and motion queue.  Moves sent over the
+ * serial interface are queued here and run one after the other, polled
+ * from main() until each one is done, so nothing waits inside the
+ * receive interrupt and the next move starts as soon as the last one
+ * is over.
+ *
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+	volatile unsigned char motion_job = MOTION_IDLE;	// Move running now
+
+// The motion queue is a ring buffer.  Each entry (segment) is a job and
+// the half steps from where the moves before it leave each axis to
+// where it drives (only the ones the job uses are looked at), with the
+// direction in the job bits.  The new_location is put back together
+// when the entry is run (see MOTION_SERVICE), so it comes out the same
+// 32 bit location that was sent, and one move can't go further than
+// 0xFFFF half steps (as AXIS_DRIVE and XYZ_DRIVE).  MOTION_QUEUE_SIZE
+// is kept small, every entry costs 7 bytes of RAM.
+	#define MOTION_JOB	0x0F	// Job bits of an entry
+	#define MOTION_BACK	0x10	// Toward HOME bit of axes[0], 0x20 axes[1], 0x40 axes[2]
+
+	unsigned char motion_queue_job[MOTION_QUEUE_SIZE];	// Queued jobs and MOTION_BACK bits
+	unsigned int motion_queue_steps[AXIS_COUNT][MOTION_QUEUE_SIZE];	// Queued half steps of each of axes
+
+	unsigned char motion_queue_head = 0;			// Next entry to run
+	unsigned char motion_queue_tail = 0;			// Next entry to fill
+	volatile unsigned char motion_queue_count = 0;	// Entries waiting
+
+// With motion_events set ('WE') the host does not have to poll 'RS' for
+// the running bits, an event frame (see SendEvent in ser.c) is sent for
+// each axis of a move, HOME or abort as soon as it is over:
+//	[0] 7 					(event size)
+//	[1] 'X', 'Y' or 'Z'
+//	[2] to [5] location, signed 32 bit MSB first (see drive_start.c)
+//	[6] EVENT_REACHED, EVENT_LIMIT or EVENT_ABORTED
+//	[7] error bits of system_status (see system_status.c)
+	volatile bit motion_events = 0;	// Off, hosts that don't know them see no change
+
+// This function, MOTION_RUN starts a move.  Each drive function only
+// sets up the drive and returns, MOTION_SERVICE polls it from there.
+void MOTION_RUN(unsigned char job)
+{
+	const axis_t *axis;
+
+	if(motion_job != MOTION_IDLE)
+	{
+		TRG_ABORT();	// Abort all XYZ movement (see abort.c)
+		MOTION_EVENT(motion_job);
+	}
+
+	UNPARK();	// The axes move, the parked position is no good (see eeprom.c)
+	motion_job = job;
+
+	if(job == MOTION_DRIVE_XYZ)
+		XYZ_DRIVE();	// (see drive_xyz.c)
+	else if(job == MOTION_HOME_XYZ)
+		HOME(0x70);		// XYZ together (see drive_home.c)
+	else
+		for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+		{
+			if(job == axis->drive_job)
+				AXIS_DRIVE(axis);		// (see drive_motor.c)
+			else if(job == axis->home_job)
+				HOME(axis->running);	// (see drive_home.c)
+		}
+
+}	// End of MOTION_RUN function
+
+// This function, MOTION_START replaces whatever is running or queued
+// with a new move (used by initialize).
+void MOTION_START(unsigned char job)
+{
+	MOTION_CLEAR();	// Forget queued moves
+	MOTION_RUN(job);
+
+}	// End of MOTION_START function
+
+// This function, MOTION_END works out where the moves running and
+// queued leave axes[a]: its new_location, 0 after a HOME, then each
+// queued move of it in turn.
+long MOTION_END(unsigned char a)
+{
+	const axis_t *axis = &axes[a];
+	unsigned char entry = motion_queue_head;
+	unsigned char job = motion_job;
+	long end;
+
+	if(job == axis->home_job || job == MOTION_HOME_XYZ)
+		end = 0;
+	else
+		end = POSITION(*axis->new_location_hi, *axis->new_location);
+
+	for( unsigned char n = motion_queue_count; n; n--)
+	{
+		job = motion_queue_job[entry];
+		if((job & MOTION_JOB) == axis->home_job || (job & MOTION_JOB) == MOTION_HOME_XYZ)
+			end = 0;
+		else if((job & MOTION_JOB) == axis->drive_job || (job & MOTION_JOB) == MOTION_DRIVE_XYZ)
+		{
+			if(job & (MOTION_BACK << a))
+				end -= motion_queue_steps[a][entry];
+			else
+				end += motion_queue_steps[a][entry];
+		}
+
+		if(++entry == MOTION_QUEUE_SIZE)
+			entry = 0;
+	}
+	return end;
+
+}	// End of MOTION_END function
+
+// This function, MOTION_ADD queues a move to run after the ones already
+// running or queued.  If the queue is full the move is dropped and the
+// Motion Queue Full error is set (see system_status.c), if it goes more
+// than 0xFFFF half steps from where the moves before it leave an axis
+// it is dropped as an invalid command.  A drive takes its new_location
+// from the message (see RX_LOCATION in ser.c), location 0 for one axis
+// and 0 to 2 for XYZ.
+void MOTION_ADD(unsigned char job)
+{
+	long to_go;	// Signed half steps of one axis
+
+	if(motion_queue_count >= MOTION_QUEUE_SIZE)
+	{
+		system_status |= 0x81;	// Motion Queue Full
+								// Error
+		return;
+	}
+
+	motion_queue_job[motion_queue_tail] = job;
+	for( unsigned char a = 0; a < AXIS_COUNT; a++)
+		if(job == axes[a].drive_job || job == MOTION_DRIVE_XYZ)
+		{
+			to_go = RX_LOCATION(job == MOTION_DRIVE_XYZ ? a : 0) - MOTION_END(a);
+			if(to_go < 0)
+			{
+				motion_queue_job[motion_queue_tail] |= MOTION_BACK << a;
+				to_go = -to_go;
+			}
+			if(to_go > 0xFFFF)
+			{
+				system_status |= 0x03; 	// Invalid command (too far for one move)
+										// Error
+				return;
+			}
+			motion_queue_steps[a][motion_queue_tail] = (unsigned int)to_go;
+		}
+
+	if(++motion_queue_tail == MOTION_QUEUE_SIZE)
+		motion_queue_tail = 0;
+	motion_queue_count++;
+
+}	// End of MOTION_ADD function
+
+// This function, MOTION_CLEAR forgets the queued moves.  It is used by
+// the abort commands so the queue does not carry on afterwards.
+void MOTION_CLEAR(void)
+{
+	motion_queue_head = 0;
+	motion_queue_tail = 0;
+	motion_queue_count = 0;
+
+}	// End of MOTION_CLEAR function
+
+// This function, MOTION_SERVICE is called over and over by main().  It
+// polls the move running now and when it is over starts the next one
+// in the queue.
+void MOTION_SERVICE(void)
+{
+	unsigned char done = 1;	// motion_job is over (MOTION_IDLE)
+	unsigned char job;		// next move queued
+	long at;				// its new_location of one axis
+	const axis_t *axis;
+
+	if(motion_job == MOTION_DRIVE_XYZ)
+		done = XYZ_DRIVE_DONE();	// (see drive_xyz.c)
+	else if(motion_job == MOTION_HOME_XYZ)
+		done = HOME_DONE();			// (see drive_home.c)
+	else if(motion_job == MOTION_VERSION)
+		send_version();	// Moves before it are done (see initialize.c)
+	else
+		for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+		{
+			if(motion_job == axis->drive_job)
+				done = AXIS_DRIVE_DONE(axis);	// (see drive_motor.c)
+			else if(motion_job == axis->home_job)
+				done = HOME_DONE();			// (see drive_home.c)
+		}
+
+	if(done)
+	{
+		MOTION_EVENT(motion_job);
+
+		// A HOME leaves new_location at 0 even if it did not get there,
+		// the queue counts from it (see MOTION_END)
+		for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+			if(motion_job == axis->home_job || motion_job == MOTION_HOME_XYZ)
+			{
+				*axis->new_location = 0;
+				*axis->new_location_hi = 0;
+			}
+		motion_job = MOTION_IDLE;
+
+		if(motion_queue_count)
+		{
+			job = motion_queue_job[motion_queue_head] & MOTION_JOB;
+
+			// Only the locations the job drives to are updated
+			for( unsigned char a = 0; a < AXIS_COUNT; a++)
+				if(job == axes[a].drive_job || job == MOTION_DRIVE_XYZ)
+				{
+					at = POSITION(*axes[a].new_location_hi, *axes[a].new_location);
+					if(motion_queue_job[motion_queue_head] & (MOTION_BACK << a))
+						at -= motion_queue_steps[a][motion_queue_head];
+					else
+						at += motion_queue_steps[a][motion_queue_head];
+					*axes[a].new_location = (unsigned short)at;
+					*axes[a].new_location_hi = (short)(at >> 16);
+				}
+
+			if(++motion_queue_head == MOTION_QUEUE_SIZE)
+				motion_queue_head = 0;
+			motion_queue_count--;
+
+			MOTION_RUN(job);
+		}
+	}
+
+}	// End of MOTION_SERVICE function
+
+// This function, AXIS_EVENT sends the event frame of one axis (see
+// motion_events above).  location and target are whole 32 bit values
+// so a stop a multiple of 65536 half steps off the target is not taken
+// for it.
+void AXIS_EVENT(unsigned char axis, long location, long target, unsigned char hit)
+{
+	SendEvent(7);
+	SendByte(axis);
+	SendByte((unsigned char)(location >> 24));
+	SendByte((unsigned char)(location >> 16));
+	SendByte((unsigned char)(location >> 8));
+	SendByte((unsigned char)(location & 0xff));
+	if(location == target)
+		SendByte(EVENT_REACHED);
+	else if(hit)
+		SendByte(EVENT_LIMIT);
+	else
+		SendByte(EVENT_ABORTED);
+	SendByte(system_status & 0x8F);	// Error bits
+	SendEnd();
+
+}	// End of AXIS_EVENT function
+
+// This function, MOTION_EVENT sends the event frames of a move that is
+// over (see MOTION_SERVICE) or replaced (see MOTION_RUN).  HOME moves
+// end at 0.  A switch hit by one axis of an XYZ move stops them all
+// (see XYZ_LIMIT in drive_xyz.c) so it is the reason for each of them.
+void MOTION_EVENT(unsigned char job)
+{
+	unsigned char home = 0;	// HOME move, the target is 0
+	unsigned char hit;		// Switches that stopped the move
+	long at, target;		// Where each axis is and was going
+	const axis_t *axis;
+
+	if(!motion_events)
+		return;
+
+	if(job == MOTION_HOME_X || job == MOTION_HOME_Y || job == MOTION_HOME_Z || job == MOTION_HOME_XYZ)
+		home = 1;
+	hit = home ? 0x00 : limit_hit;	// HOME stops at its switches on purpose
+
+	for(axis = axes; axis < axes + AXIS_COUNT; axis++)
+	{
+		// The drives are stopped, no need for LOCATION (see drive_start.c)
+		at = POSITION(*axis->location_hi, *axis->location);
+		target = home ? 0 : POSITION(*axis->new_location_hi, *axis->new_location);
+		if(job == axis->drive_job || job == axis->home_job)
+			AXIS_EVENT(axis->name, at, target, hit & axis->limits);
+		else if(job == MOTION_DRIVE_XYZ || job == MOTION_HOME_XYZ)
+			AXIS_EVENT(axis->name, at, target, hit);
+	}
+
+}	// End of MOTION_EVENT function
+
+//  This reads the motion queue state.  The format is:
+//  [0] 3 					(transmit size)
+//  [1] motion_queue_count	(moves queued, not counting the one running)
+//  [2] free queue entries
+//  [3] motion_job			(move running now, 0 = MOTION_IDLE)
+void read_motion_queue(void)
+{
+	SendStart(3);	// Returning 3 chars
+	SendByte(motion_queue_count);
+	SendByte(MOTION_QUEUE_SIZE - motion_queue_count);
+	SendByte(motion_job);
+	SendEnd();
+
+}	// End of read_motion_queue function
+
+// This is the serial interface to turn the event frames on or off.
+// The format is:
+//	[0] [1] 'WE': Write Events
+//  [2] 0 = off, 1 = an event frame when each move is over
+void write_events(void)
+{
+	if(rx_arg > 1)
+		system_status |= 0x03; 	// Invalid command
+								// Error
+	else
+		motion_events = rx_arg;
+}	// End of write_events function
@@ -1,259 +1,385 @@
-/*
- * ser.c
- *
- * This contains the serial interface code for sending and executing on received data.  
- * 
-*/
-
-#include <pic.h>
-#include "globals.h"
-
-	volatile unsigned char rxfifo[SER_BUFFER_SIZE];			// Receive Buffer
-	volatile bank1 unsigned char txfifo[SER_BUFFER_SIZE];	// Transmit Buffer
-
-// This will write (TX) the txfifo buffer. It will handle
-// the setup and transmission.
-void SendData(void)
-{
-
-// The TXIF interrupt can be enabled by setting the TXIE
-// interrupt enable bit of the PIE1 register. However, the
-// TXIF flag bit will be set whenever the TXREG is empty,
-// regardless of the state of TXIE enable bit.
-
-	GIE = 0; // Disable general Interrupts while sending data
-
-	// The first char sent back will be the message size
-	// Send buffer based on the number of characters specified by 'TX_Size'
-	for( unsigned char a = 0; a < SER_BUFFER_SIZE && a < txfifo[0]+1; a++)
-	{
-		TXREG = txfifo[a];  // The transmission of the Start bit, 
-							// data bits and Stop bit sequence commences 
-							// immediately following the transfer of the 
-							// data to the TSR from the TXREG.
-		
-		// TXIF may not be valid for one instruction cycle. This will 
-		// poll the flag looking for the TXREG to become empty indicating
-		// the data has been shifted to TSR.  Polling 2000 times eliminates
-		// a lockup condition that may occur if something 'bad' happens.		
-		for( int poll = 0; poll < 1000 && TXIF != 1; poll++);
-	}
-	
-	GIE = 1; // Re-enable general Interrupts
-	
-//	TXEN = 0;	// Disable the transmitter (not using interrupt)
-	
-}	// End SendData
-
-// This function does the actual work.  Because functions are acted on based
-// on serial communications, to speed up the proccessing of the request it is
-// important to keep the received message as short as possible.  Here are the 
-// available current settings as they should be sent to this serial interface.
-//
-// Note: the first byte sent is the message size in decimal.  The receive 
-// interrupt routine will remove this message size byte prior to this call 
-// being made:
-//
-//		'1I'  -  Initialize, set Drive Mode and send XYZ HOME (see initialize.c)
-//		'2AA' -  Abort all (XYZ) drive (see abort.c)
-//		'2AX' -  Abort X Drive (see abort.c)
-//		'2AY' -  Abort Y Drive (see abort.c)
-//		'2AZ' -  Abort Y Drive (see abort.c)
-//		'5SNX**' - Send X to new '**' step location, where ** = 0 to 0xFFFF steps (see drive_motor.c)
-//		'5SNY**' - Send Y to new '**' step location, where ** = 0 to 0xFFFF steps (see drive_motor.c)
-//		'5SNZ**' - Send Z to new '**' step location, where ** = 0 to 0xFFFF steps (see drive_motor.c)
-//		'3SHA' - Send All (XYZ) to HOME position (see drive_home.c)
-//		'3SHX' - Send X to HOME position (see drive_home.c)
-//		'3SHY' - Send Y to HOME position (see drive_home.c)
-//		'3SHZ' - Send Z to HOME position (see drive_home.c)
-//		'4WVX*' - Write X-Drive Vref, where X = 0 to 31 dec and is a ratio of 1.024 (see vref.c)
-//		'4WVY*' - Write Y-Drive Vref, where X = 0 to 31 dec and is a ratio of 1.024 (see vref.c)
-//		'4WVZ*' - Write Z-Drive Vref, where X = 0 to 31 dec and is a ratio of 1.024 (see vref.c)
-//		'5WFX**' - Write X_max_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
-//		'5WFY**' - Write Y_max_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
-//		'5WFZ**' - Write Z_max_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
-//		'5WSX**' - Write X_min_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
-//		'5WSY**' - Write Y_min_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
-//		'5WSZ**' - Write Z_min_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
-//		'2RS'  - Read System Status (see system_status.c)
-//		'2RL'  - Read Limit Status (see system_status.c)
-//		'3RVX' - Read X-Drive Vref (see vref.c)
-//		'3RVY' - Read Y-Drive Vref (see vref.c)
-//		'3RVZ' - Read Z-Drive Vref (see vref.c)
-//		'3RPX' - Read Position of X with respect to HOME (see drive_start.c)
-//		'3RPY' - Read Position of Y with respect to HOME (see drive_start.c)
-//		'3RPZ' - Read Position of Z with respect to HOME (see drive_start.c)
-//		'2CS'  - Clear System Status (see system_status.c)
-//		'2CL'  - Clear Limit Status (see system_status.c)
-//
-// These commands could be expanded if needed.
-void Execute(void)
-{
-	//  This function was called from the ISR and may have disabled
-	//  the GIE.  We want it restored so any function called will 
-	//  execute correctly.
-	GIE = 1;	// GIE PEIE TMR0IE INTE IOCIE TMR0IF INTF IOCIF
-	
-	// Check first byte for one of the above listed commands.
-	if(  rxfifo[0] == 'A')	// Abort or Stop (See abort.c) 
-	{
-		if(rxfifo[1] == 'A')
-			TRG_ABORT();	// XYZ abort All	
-		else if(rxfifo[1] == 'X') 
-			X_ABORT();		// X abort
-		else if(rxfifo[1] == 'Y') 
-			Y_ABORT();		// Y abort
-		else if(rxfifo[1] == 'Z') 
-			Z_ABORT();		// Z abort
-		else
-			system_status |= 0x03; 	// Invalid command
-									// Error
-	}
-	else if(  rxfifo[0] == 'R')	// Read  
-	{
-		if(rxfifo[1] == 'S')	// System Status (see system_status.c) 
-		{
-			txfifo[1] = system_status; 	
-			txfifo[0] = 1;			// Returning one char
-		}
-		else if(rxfifo[1] == 'L')	// Limit Status (see system_status.c)
-		{
-			txfifo[1] = ~(PORTC); 	
-			txfifo[0] = 1;			// Returning one char
-		}
-		else if(rxfifo[1] == 'P')	// Position
-		{ 
-			if(rxfifo[2] == 'X')
-				read_X_position();		//  Read Current X_location
-			else if(rxfifo[2] == 'Y')
-				read_Y_position();		//  Read Current Y_location
-			else if(rxfifo[2] == 'Z')
-				read_Z_position();		//  Read Current Z_location
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-		else if(rxfifo[1] == 'V')	// VREF
-		{ 
-			if(rxfifo[2] == 'X')
-				read_X_VREF();		//  Read Current X Vref Setting
-			else if(rxfifo[2] == 'Y')
-				read_Y_VREF();		//  Read Current Y Vref Setting
-			else if(rxfifo[2] == 'Z')
-				read_Z_VREF();		//  Read Current Z Vref Setting
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-		else
-			system_status |= 0x03; 	// Invalid command
-									// Error
-		
-		SendData();	// return data								
-	}
-	else if(  rxfifo[0] == 'C')	// Clear (see system_status.c) 
-	{
-		if(rxfifo[1] == 'S')
-			clear_system_status();	// System Status
-		else if(rxfifo[1] == 'L')
-			clear_limit_status();	// Limit Status
-		else
-			system_status |= 0x03; 	// Invalid command
-									// Error
-	}										
-	else if(  rxfifo[0] == 'I')	// Intialize XYZ to HOME and return FW version
-	{
-		initialize();	// See (initialize.c)
-		SendData();		// return data
-	}
-	else if(  rxfifo[0] == 'S')	// Send  
-	{
-		if(rxfifo[1] == 'N')	// New location
-		{
-			if(rxfifo[2] == 'X')
-				send_new_X(); 	// Send to New X location (see drive_motor.c)	
-			else if(rxfifo[2] == 'Y') 
-				send_new_Y(); 	// Send to New Y location (see drive_motor.c)
-			else if(rxfifo[2] == 'Z') 
-				send_new_Z(); 	// Send to New Z location (see drive_motor.c)
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-		else if(rxfifo[1] == 'H')	// HOME
-		{	
-			if(rxfifo[2] == 'A')	// Send All HOME
-			{
-				Z_HOME(); 		// Send to Z HOME (see drive_home.c)
-				X_HOME(); 		// Send to X HOME (see drive_home.c)
-				Y_HOME(); 		// Send to Y HOME (see drive_home.c)
-			}	
-			else if(rxfifo[2] == 'X')
-				X_HOME(); 		// Send to X HOME (see drive_home.c)	
-			else if(rxfifo[2] == 'Y') 
-				Y_HOME(); 		// Send to Y HOME (see drive_home.c)
-			else if(rxfifo[2] == 'Z') 
-				Z_HOME(); 		// Send to Z HOME (see drive_home.c)
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-	}	
-	else if(  rxfifo[0] == 'W')	// Write  
-	{
-		if(rxfifo[1] == 'V')	// Voltage Reference
-		{
-			if(rxfifo[2] == 'X')
-				write_X_VREF(); 	// Write X vref (see vref.c)	
-			else if(rxfifo[2] == 'Y') 
-				write_Y_VREF(); 	// Write Y vref (see vref.c)
-			else if(rxfifo[2] == 'Z') 
-				write_Z_VREF(); 	// Write Z vref (see vref.c)
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-		else if(rxfifo[1] == 'F')	// Write Fastest Step Speed
-		{
-			if(rxfifo[2] == 'X')
-				write_X_fast(); 	// Write X_max_speed (see drive_timer.c)	
-			else if(rxfifo[2] == 'Y') 
-				write_Y_fast(); 	// Write Y_max_speed (see drive_timer.c)
-			else if(rxfifo[2] == 'Z') 
-				write_Z_fast(); 	// Write Z_max_speed (see drive_timer.c)
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-		else if(rxfifo[1] == 'S')	// Write Slowest Step Speed
-		{
-			if(rxfifo[2] == 'X')
-				write_X_slow(); 	// Write X_min_speed (see drive_timer.c)	
-			else if(rxfifo[2] == 'Y') 
-				write_Y_slow(); 	// Write Y_min_speed (see drive_timer.c)
-			else if(rxfifo[2] == 'Z') 
-				write_Z_slow(); 	// Write Z_min_speed (see drive_timer.c)
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-		else if(rxfifo[1] == 'P')	// Write Position
-		{
-			if(rxfifo[2] == 'X')
-				write_X_position(); 	// Write X location
-			else if(rxfifo[2] == 'Y') 
-				write_Y_position(); 	// Write Y location
-			else if(rxfifo[2] == 'Z') 
-				write_Z_position(); 	// Write Z location
-			else
-				system_status |= 0x03; 	// Invalid command
-										// Error
-		}
-		else
-			system_status |= 0x03; 	// Invalid command
-									// Error								
-	}	
-	else
-		system_status |= 0x03; 	// Invalid command
-								// Error
-}	// End Execute
+/*
+ * ser.c
+ *
+ * This contains the serial interface code for sending and executing on received data.  
+ * 
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+	volatile unsigned char rxfifo[SER_BUFFER_SIZE];			// Receive Buffer
+
+// The transmit ring buffer.  The handlers build their reply straight in
+// here with SendStart, SendByte and SendEnd
+// and the TX interrupt (see isr in main.c) moves it to TXREG one char at
+// a time, so nothing waits on the transmitter with interrupts off.  The
+// head is only changed by the isr and the tail only by tx_put so no
+// interrupt disable is needed.  One entry is always left empty to tell a
+// full ring from an empty one.
+	volatile bank1 unsigned char txring[TX_RING_SIZE];	// Transmit Ring Buffer
+	volatile unsigned char tx_head = 0;	// Next char to transmit (isr)
+	volatile unsigned char tx_tail = 0;	// Next free entry (tx_put)
+	unsigned char tx_crc = 0;			// CRC-8 of the frame being sent
+
+// This works out the CRC-8 (x^8 + x^2 + x + 1, 0x07) of one more char.
+// Frames in both directions carry the CRC-8 of their size and message
+// chars, starting from 0x00.
+unsigned char crc8(unsigned char crc, unsigned char data)
+{
+	crc ^= data;
+	for( unsigned char b = 0; b < 8; b++)
+	{
+		if(crc & 0x80)
+			crc = (crc << 1) ^ 0x07;
+		else
+			crc = crc << 1;
+	}
+	return crc;
+
+}	// End crc8
+
+// This will put one char in the transmit ring and turn on the TX
+// interrupt.  If the ring is full this waits (with interrupts on) for
+// the isr to make room, which it does every char time (520 uSec at
+// 19200, the slowest rate) since TXEN is never turned off.  Nothing
+// is dropped, a reply longer than the ring just goes out at line rate.
+void tx_put(unsigned char data)
+{
+	unsigned char next = (tx_tail + 1) & (TX_RING_SIZE - 1);
+
+	while(next == tx_head)
+		HAL_IDLE();		// Ring full, the isr moves one to TXREG
+
+	txring[tx_tail] = data;
+	tx_tail = next;
+
+// The TXIF interrupt can be enabled by setting the TXIE
+// interrupt enable bit of the PIE1 register. However, the
+// TXIF flag bit will be set whenever the TXREG is empty,
+// regardless of the state of TXIE enable bit.
+	TXIE = 1;	// isr sends it (see main.c)
+
+}	// End tx_put
+
+// This starts a reply frame: SER_SOF and the number of chars to follow.
+// The chars are then sent with SendByte and the frame closed with
+// SendEnd.
+void SendStart(unsigned char size)
+{
+	tx_put(SER_SOF);
+	tx_crc = crc8(0x00, size);
+	tx_put(size);
+
+}	// End SendStart
+
+// This starts an event frame, sent without being asked for when a move
+// is over (see MOTION_EVENT in motion.c).  It is framed like a reply
+// with SER_EVENT in place of SER_SOF so the host can tell them apart.
+void SendEvent(unsigned char size)
+{
+	tx_put(SER_EVENT);
+	tx_crc = crc8(0x00, size);
+	tx_put(size);
+
+}	// End SendEvent
+
+// This sends one char of a reply frame (see SendStart).
+void SendByte(unsigned char data)
+{
+	tx_crc = crc8(tx_crc, data);
+	tx_put(data);
+
+}	// End SendByte
+
+// This ends a reply frame with its CRC-8 (see SendStart).
+void SendEnd(void)
+{
+	tx_put(tx_crc);
+
+}	// End SendEnd
+
+// This takes location n of the message out of rxfifo (see Execute).
+// Locations are sent as 2 chars, 0 to 0xFFFF, or wide as 4 chars,
+// signed 32 bit, both MSB first.
+long RX_LOCATION(unsigned char n)
+{
+	unsigned char a = rx_arg_at + (rx_wide ? 4 * n : 2 * n);
+
+	if(!rx_wide)
+		return (unsigned int)((rxfifo[a] << 8) | rxfifo[a + 1]);
+
+	return ((long)(signed char)rxfifo[a] << 24) | ((long)rxfifo[a + 1] << 16)
+			| ((unsigned int)rxfifo[a + 2] << 8) | rxfifo[a + 3];
+
+}	// End RX_LOCATION
+
+// This function does the actual work.  Because functions are acted on based
+// on serial communications, to speed up the proccessing of the request it is
+// important to keep the received message as short as possible.  Here are the 
+// available current settings as they should be sent to this serial interface.
+//
+// Note: every message is sent as a frame:
+//
+//		SER_SOF (0x7E), message size, message, CRC-8
+//
+// The message size is in decimal (1 to SER_BUFFER_SIZE) and is shown in
+// front of each command below.  The CRC-8 (see crc8) covers the size and
+// the message.  Replies are framed the same way.  A frame with a bad size
+// is thrown away as soon as the size is seen, a frame stopped part way is
+// thrown away after RX_TIMEOUT_MS, and either way the receiver looks for
+// the next SER_SOF.  The receive interrupt routine will remove the framing
+// and flag rx_ready for main() to make this call.  Moves (SN and SH) are
+// queued and run one after the other in the background (see motion.c).
+// Aborts also empty the queue.  With 'WE' set, the end of every move is
+// sent as an event frame starting with SER_EVENT (0x7D) instead of
+// SER_SOF, in between replies (see MOTION_EVENT in motion.c).
+//
+// Locations are in half steps.  They can be sent and read as signed 32
+// bit values but one move (SN) only goes up to 0xFFFF half steps on each
+// axis, counted from where the move before it leaves the axis.  A move
+// that goes further is refused with the Invalid Serial Command bits and
+// nothing moves, the host has to send it as two or more moves.
+//
+// A drive stops at a limit switch before the step that would make it,
+// except Z in the CCP3 PWM step mode ('WMZ' 1).  There CCP3 has made the
+// step before the interrupt sees it, so Z stops one step past where its
+// switch closed and its location and limit hit say so.
+//
+//
+//		'1I'  -  Initialize, set Drive Mode and send XYZ HOME (see initialize.c)
+//		'2AA' -  Abort all (XYZ) drive (see abort.c)
+//		'2AX' -  Abort X Drive (see abort.c)
+//		'2AY' -  Abort Y Drive (see abort.c)
+//		'2AZ' -  Abort Y Drive (see abort.c)
+//		'5SNX**' - Send X to new '**' step location, where ** = 0 to 0xFFFF steps, up to 0xFFFF steps away (see drive_motor.c)
+//		'7SNX****' - Send X to new '****' step location, signed 32 bit, up to 0xFFFF steps away (see drive_motor.c)
+//		'5SNY**' - Send Y to new '**' step location, where ** = 0 to 0xFFFF steps, up to 0xFFFF steps away (see drive_motor.c)
+//		'7SNY****' - Send Y to new '****' step location, signed 32 bit, up to 0xFFFF steps away (see drive_motor.c)
+//		'5SNZ**' - Send Z to new '**' step location, where ** = 0 to 0xFFFF steps, up to 0xFFFF steps away (see drive_motor.c)
+//		'7SNZ****' - Send Z to new '****' step location, signed 32 bit, up to 0xFFFF steps away (see drive_motor.c)
+//		'9SNA******' - Send XYZ together to new X '**', Y '**', Z '**' step locations, each up to 0xFFFF steps away (see drive_xyz.c)
+//		'15SNA************' - Send XYZ together to new X '****', Y '****', Z '****' signed 32 bit step locations, each up to 0xFFFF steps away (see drive_xyz.c)
+//		'3SHA' - Send All (XYZ) to HOME position together (see drive_home.c)
+//		'3SHX' - Send X to HOME position (see drive_home.c)
+//		'3SHY' - Send Y to HOME position (see drive_home.c)
+//		'3SHZ' - Send Z to HOME position (see drive_home.c)
+//		'4WVX*' - Write X-Drive Vref, where X = 0 to 31 dec and is a ratio of 1.024 (see vref.c)
+//		'4WVY*' - Write Y-Drive Vref, where X = 0 to 31 dec and is a ratio of 1.024 (see vref.c)
+//		'4WVZ*' - Write Z-Drive Vref, where X = 0 to 31 dec and is a ratio of 1.024 (see vref.c)
+//		'4WRX*' - Write X-Drive Reference, * = 0 DACOUT, 1 CCP2 PWM on RB3 (board option, see vref.c)
+//		'5WHX**' - Write X HOME approach speed, where ** = 0 to 0xFFFF Hz (see drive_home.c)
+//		'5WHY**' - Write Y HOME approach speed, where ** = 0 to 0xFFFF Hz (see drive_home.c)
+//		'5WHZ**' - Write Z HOME approach speed, where ** = 0 to 0xFFFF Hz (see drive_home.c)
+//		'4WHO*' - Write HOME Order, * = 0 XYZ together, 1 Z first (see drive_home.c)
+//		'5WTX**' - Write X-Drive Vref settle Time, where ** = 0 to 0xFFFF mSec (see vref.c)
+//		'5WTY**' - Write Y-Drive Vref settle Time, where ** = 0 to 0xFFFF mSec (see vref.c)
+//		'5WTZ**' - Write Z-Drive Vref settle Time, where ** = 0 to 0xFFFF mSec (see vref.c)
+//		'5WFX**' - Write X_max_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
+//		'5WFY**' - Write Y_max_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
+//		'5WFZ**' - Write Z_max_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
+//		'5WSX**' - Write X_min_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
+//		'5WSY**' - Write Y_min_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
+//		'5WSZ**' - Write Z_min_speed to new '**' frequency, where ** = 0 to 0xFFFF Hz (see drive_timer.c)
+//		'5WAX**' - Write X_accel to new '**' Hz per step, where ** = 0 to 0xFFFF (see drive_ramp.c)
+//		'5WAY**' - Write Y_accel to new '**' Hz per step, where ** = 0 to 0xFFFF (see drive_ramp.c)
+//		'5WAZ**' - Write Z_accel to new '**' Hz per step, where ** = 0 to 0xFFFF (see drive_ramp.c)
+//		'4WCX*' - Write X S-Curve ramp, * = 1 to 0xFF half steps per table entry, 0 linear ramp (see drive_ramp.c)
+//		'4WCY*' - Write Y S-Curve ramp, * = 1 to 0xFF half steps per table entry, 0 linear ramp (see drive_ramp.c)
+//		'4WCZ*' - Write Z S-Curve ramp, * = 1 to 0xFF half steps per table entry, 0 linear ramp (see drive_ramp.c)
+//		'5WNX**' - Write X full step Near distance, HALF step for the last ** = 0 to 0xFFFF half steps, 0 HALF step only (see drive_mode.c)
+//		'5WNY**' - Write Y full step Near distance, HALF step for the last ** = 0 to 0xFFFF half steps, 0 HALF step only (see drive_mode.c)
+//		'5WNZ**' - Write Z full step Near distance, HALF step for the last ** = 0 to 0xFFFF half steps, 0 HALF step only (see drive_mode.c)
+//		'3WE*' - Write Events, * = 0 off, 1 an event frame when each move is over (see motion.c)
+//		'4WMZ*' - Write Z step Mode, * = 0 STEP from the interrupt, 1 STEP from CCP3 PWM, stops one step past a limit switch (see drive_pwm.c)
+//		'5WPX**' or '7WPX****' - Write Position of X, 0 to 0xFFFF or signed 32 bit (see drive_start.c)
+//		'5WPY**' or '7WPY****' - Write Position of Y, 0 to 0xFFFF or signed 32 bit (see drive_start.c)
+//		'5WPZ**' or '7WPZ****' - Write Position of Z, 0 to 0xFFFF or signed 32 bit (see drive_start.c)
+//		'2RS'  - Read System Status (see system_status.c)
+//		'2RL'  - Read Limit Status (see system_status.c)
+//		'2RH'  - Read limit Hits: switches that stopped a drive, X, Y and Z location at the hit, 32 bit (see system_status.c)
+//		'2RA'  - Read All: 32 bit locations, new locations, status, limits, Vref and motion in one frame (see system_status.c)
+//		'2RQ'  - Read Motion Queue: queued moves, free entries, move running (see motion.c)
+//		'3RVX' - Read X-Drive Vref (see vref.c)
+//		'3RVY' - Read Y-Drive Vref (see vref.c)
+//		'3RVZ' - Read Z-Drive Vref (see vref.c)
+//		'3RVT' - Read Time drives were held waiting on Vref, 4 chars mSec (see vref.c)
+//		'3RPX' - Read Position of X with respect to HOME, low 16 bits (see drive_start.c)
+//		'3REX' - Read Extended Position of X with respect to HOME, 4 chars signed 32 bit (see drive_start.c)
+//		'3RPY' - Read Position of Y with respect to HOME, low 16 bits (see drive_start.c)
+//		'3REY' - Read Extended Position of Y with respect to HOME, 4 chars signed 32 bit (see drive_start.c)
+//		'3RPZ' - Read Position of Z with respect to HOME, low 16 bits (see drive_start.c)
+//		'3REZ' - Read Extended Position of Z with respect to HOME, 4 chars signed 32 bit (see drive_start.c)
+//		'2CS'  - Clear System Status (see system_status.c)
+//		'2CL'  - Clear Limit Status (see system_status.c)
+//		'2NW'  - Non-volatile Write settings to EEPROM, returns the bytes written or 0xFF if moving or before 'BC' (see eeprom.c)
+//		'2NE'  - Non-volatile Erase settings, RAM defaults at the next power up (see eeprom.c)
+//		'2NP'  - Non-volatile Park, save the position, returns 1 or 0 if moving (see eeprom.c)
+//		'2NI'  - Non-volatile Initialize, parked position or HOME like 'I', returns FW version (see eeprom.c)
+//		'3BS*' - Baud rate Set to table entry '*', 0 = 19200 to 7 = 1000000, reply at the old rate (see baud.c)
+//		'2BC'  - Baud rate Confirm, sent at the new rate within BAUD_CONFIRM_MS or back to 19200 (see baud.c)
+//
+// Commands are added as a row of the commands_ table of their first
+// char below, Execute itself does not change.
+//
+// Each row is one command: its second command char, the axis char that
+// follows, where its arguments start in rxfifo and how many chars they
+// are, and its handler.  An axis of AXIS_ANY takes the name of any of
+// axes[] (see axis.c) and calls axis_handler with it, any other axis
+// char takes only that char and 0 none, they call handler.  The message
+// size is checked here once for all of them and a 1 or 2 char argument
+// is left in rx_arg, locations are read with RX_LOCATION.  Handlers
+// that reply send it themselves (see SendStart).
+	#define AXIS_ANY	1	// Row for every axis (not a command char)
+
+	typedef struct
+	{
+		unsigned char op;			// Second command char, 0 for one char commands
+		unsigned char axis;			// AXIS_ANY, another axis char, or 0
+		unsigned char arg;			// Where the arguments start in rxfifo
+		unsigned char arg_size;		// Argument chars
+		unsigned char wide;			// Also this many (4 char locations), 0 none
+		void (*handler)(void);		// Handler without AXIS_ANY
+		void (*axis_handler)(const axis_t *axis);	// Handler with AXIS_ANY
+	} command_t;
+
+	unsigned int rx_arg = 0;		// 1 or 2 char argument, MSB first (see Execute)
+	unsigned char rx_arg_at = 0;	// Where the arguments start in rxfifo
+	bit rx_wide = 0;				// Locations are 4 chars (see RX_LOCATION)
+
+	const command_t commands_S[] = {
+		{ 'N', AXIS_ANY, 3, 2, 4,	0, send_new },			// (see drive_motor.c)
+		{ 'N', 'A', 3, 6, 12,		send_new_XYZ },			// (see drive_xyz.c)
+		{ 'H', AXIS_ANY, 3, 0, 0,	0, send_home },			// (see drive_home.c)
+		{ 'H', 'A', 3, 0, 0,		send_home_all },
+	};
+
+	const command_t commands_R[] = {
+		{ 'S', 0, 2, 0, 0,			read_system_status },	// (see system_status.c)
+		{ 'A', 0, 2, 0, 0,			read_all_status },		// Sent as it is read
+		{ 'L', 0, 2, 0, 0,			tx_read_limit_status },
+		{ 'H', 0, 2, 0, 0,			read_limit_hit },
+		{ 'Q', 0, 2, 0, 0,			read_motion_queue },	// (see motion.c)
+		{ 'P', AXIS_ANY, 3, 0, 0,	0, read_position },		// (see drive_start.c)
+		{ 'E', AXIS_ANY, 3, 0, 0,	0, read_position_long },
+		{ 'V', AXIS_ANY, 3, 0, 0,	0, read_axis_VREF },	// (see vref.c)
+		{ 'V', 'T', 3, 0, 0,		read_vref_wait },
+	};
+
+	const command_t commands_A[] = {
+		{ 0, 'A', 2, 0, 0,			abort_all },			// (see abort.c)
+		{ 0, AXIS_ANY, 2, 0, 0,		0, abort_axis },
+	};
+
+	const command_t commands_W[] = {
+		{ 'V', AXIS_ANY, 3, 1, 0,	0, write_axis_VREF },	// (see vref.c)
+		{ 'R', 'X', 3, 1, 0,		write_X_vref_source },	// No CCP pin for Y/Z VREF
+		{ 'T', AXIS_ANY, 3, 2, 0,	0, write_settle },
+		{ 'H', AXIS_ANY, 3, 2, 0,	0, write_home_speed },	// (see drive_home.c)
+		{ 'H', 'O', 3, 1, 0,		write_home_order },
+		{ 'F', AXIS_ANY, 3, 2, 0,	0, write_fast },		// (see drive_timer.c)
+		{ 'S', AXIS_ANY, 3, 2, 0,	0, write_slow },
+		{ 'A', AXIS_ANY, 3, 2, 0,	0, write_accel },		// (see drive_ramp.c)
+		{ 'C', AXIS_ANY, 3, 1, 0,	0, write_scurve },
+		{ 'N', AXIS_ANY, 3, 2, 0,	0, write_full_near },	// (see drive_mode.c)
+		{ 'M', 'Z', 3, 1, 0,		write_Z_step_mode },	// No CCP on X/Y STEP (see drive_pwm.c)
+		{ 'P', AXIS_ANY, 3, 2, 4,	0, write_position },	// (see drive_start.c)
+		{ 'E', 0, 2, 1, 0,			write_events },			// (see motion.c)
+	};
+
+	const command_t commands_C[] = {
+		{ 'S', 0, 2, 0, 0,			clear_system_status },	// (see system_status.c)
+		{ 'L', 0, 2, 0, 0,			clear_limit_status },
+	};
+
+	const command_t commands_N[] = {
+		{ 'W', 0, 2, 0, 0,			write_settings },		// (see eeprom.c)
+		{ 'E', 0, 2, 0, 0,			erase_settings },
+		{ 'P', 0, 2, 0, 0,			write_park },
+		{ 'I', 0, 2, 0, 0,			initialize_parked },
+	};
+
+	const command_t commands_B[] = {
+		{ 'S', 0, 2, 1, 0,			write_baud },			// (see baud.c)
+		{ 'C', 0, 2, 0, 0,			confirm_baud },
+	};
+
+	const command_t commands_I[] = {
+		{ 0, 0, 1, 0, 0,			initialize },			// Returns data when HOME (see initialize.c)
+	};
+
+	#define ROWS(table)	(sizeof(table) / sizeof(command_t))
+
+void Execute(void)
+{
+	unsigned char crc = crc8(0x00, RX_Size);	// CRC-8 of the message
+	const command_t *c;		// Row of the command
+	unsigned char rows;		// Rows left with its first char
+	unsigned char name;		// Its axis char
+	const axis_t *axis = 0;	// Axis of an AXIS_ANY row
+
+	for( unsigned char a = 0; a < RX_Size; a++)
+		crc = crc8(crc, rxfifo[a]);
+
+	if(crc != rx_crc)
+	{
+		system_status |= 0x03; 	// Invalid command (corrupted)
+								// Error
+		return;
+	}
+
+// The table of the first char, then the row of the second and axis char.
+// This is a scan of that table, O(rows) and not constant time, on
+// purpose: the longest table (commands_W) is a dozen rows, well inside one
+// char time at 1 MBaud, and a table indexed by the second char as well
+// would cost more flash than Execute does.
+	switch(rxfifo[0])
+	{
+		case 'S':	c = commands_S;	rows = ROWS(commands_S);	break;
+		case 'R':	c = commands_R;	rows = ROWS(commands_R);	break;
+		case 'A':	c = commands_A;	rows = ROWS(commands_A);	break;
+		case 'W':	c = commands_W;	rows = ROWS(commands_W);	break;
+		case 'C':	c = commands_C;	rows = ROWS(commands_C);	break;
+		case 'N':	c = commands_N;	rows = ROWS(commands_N);	break;
+		case 'B':	c = commands_B;	rows = ROWS(commands_B);	break;
+		case 'I':	c = commands_I;	rows = ROWS(commands_I);	break;
+		default:	c = 0;			rows = 0;					break;
+	}
+
+	for( ; rows; rows--, c++)
+	{
+		if(c->op && c->op != rxfifo[1])
+			continue;
+
+		name = rxfifo[c->op ? 2 : 1];
+		if(c->axis == AXIS_ANY)
+		{
+			if(AXIS_INDEX(name) < AXIS_COUNT)
+			{
+				axis = &axes[AXIS_INDEX(name)];
+				break;
+			}
+		}
+		else if(!c->axis || c->axis == name)
+			break;
+	}
+
+	if(!rows || (RX_Size != c->arg + c->arg_size && (!c->wide || RX_Size != c->arg + c->wide)))
+	{
+		system_status |= 0x03; 	// Invalid command
+								// Error
+		return;
+	}
+
+	rx_arg_at = c->arg;
+	rx_wide = (RX_Size != c->arg + c->arg_size);
+	rx_arg = rxfifo[c->arg];
+	if(c->arg_size == 2)
+		rx_arg = (rx_arg << 8) | rxfifo[c->arg + 1];
+
+	if(c->axis == AXIS_ANY)
+		c->axis_handler(axis);
+	else
+		c->handler();
+
+}	// End Execute
@@ -1,73 +1,220 @@
-/*
- * system_status.c
- *
- * Contains System Status and Error information functions.
+/*
+ * system_status.c
+ *
+ * Contains System Status and Error information functions.
  * 
-*/
-
-#include <pic.h>
-#include "globals.h"
-
-// Bits of the following register will contain information of the Limit
-// status.  This is 'cheap and easy' but is also not that hard to maintain
-// and use. It should usually be ored with it's self when updated such as:
-//		 limit_status = limit_status | 0bXXXXXXXX;
-// The part that is tricky about this is keeping track of what bit means what.
-//	Status:
-//	0bXXXX XXX1 	X Home Status (RC0, X-H)
-//	0bXXXX XX1X 	X Far From Home (RC1, X-FFH)
-//	0bXXXX X1XX 	Y Home Status (RC2, Y-H)
-//	0bXXXX 1XXX 	Y Far From Home (RC3, Y-FFH)
-//	0bXXX1 XXXX 	Z Home Status (RC4, Z-H)
-// 	0bXX1X XXXX 	Z Far From Home (RC5, Z-FFH)
-// 	0bXXXX XXXX 	Not Used
-// 	0bXXXX XXXX 	Not Used
-	volatile unsigned char limit_status = 0x00;		// Contains Limit Switch Status Info
-	
-// The following will read the status of XYZ limits
-void read_limit_status(void)
-{
-	limit_status = ~(PORTC);
-}// End read_limit_status function	
-
-// The following will read the status of XYZ limits for transmit
-void tx_read_limit_status(void)
-{
-	txfifo[1] = ~(PORTC); 	
-	txfifo[0] = 1;			// Returning one char
-}// End read_limit_status function	
-
-// The Following will clear the limit status
-void clear_limit_status(void)
-{
-	limit_status = 0b00000000; // Clear Limit Status	
-}// End clear_limit_status function
-
-// Bits of the following register will contain System Status Information
-// as follows:
-// 
-//	Errors:
-//	0bXXXX XXX1 	System Error
-//	0bXXXX XX1Y 	Invalid Serial Command
-//	0bXXXX X1XY 	VREF value Error
-//	0bXXXX 1XXY 	Period value Error
-//	Status:
-//	0bXXX1 XXXX 	X-Drive Running
-// 	0bXX1X XXXX 	Y-Drive Running
-// 	0bX1XX XXXX 	Z-Drive Running
-// 	0bYXXX XXXX 	Not Used
-	volatile unsigned char system_status = 0x00; 	// Contains System Status Info
-	
-// The following will read the system status
-void read_system_status(void)
-{
-	txfifo[1] = system_status; 	
-	txfifo[0] = 1;			// Returning one char
-}// End read_system_status function	
-
-// The Following will clear the limit status
-void clear_system_status(void)
-{
-	system_status = 0b00000000; // Clear Limit Status	
-}// End read_system_status function
-
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+// Bits of the following register will contain information of the Limit
+// status.  This is 'cheap and easy' but is also not that hard to maintain
+// and use. It should usually be ored with it's self when updated such as:
+//		 limit_status = limit_status | 0bXXXXXXXX;
+// The part that is tricky about this is keeping track of what bit means what.
+//	Status:
+//	0bXXXX XXX1 	X Home Status (RC0, X-H)
+//	0bXXXX XX1X 	X Far From Home (RC1, X-FFH)
+//	0bXXXX X1XX 	Y Home Status (RC2, Y-H)
+//	0bXXXX 1XXX 	Y Far From Home (RC3, Y-FFH)
+//	0bXXX1 XXXX 	Z Home Status (RC4, Z-H)
+// 	0bXX1X XXXX 	Z Far From Home (RC5, Z-FFH)
+// 	0bXXXX XXXX 	Not Used
+// 	0bXXXX XXXX 	Not Used
+	volatile unsigned char limit_status = 0x00;		// Contains Limit Switch Status Info
+
+// The limit switches are checked by the step interrupts (see isr in
+// main.c) just before each STEP edge, for the switch in the direction
+// of travel only.  A hit stops that drive's timer right there, so no
+// step is ever taken past a switch, and latches the location it was
+// hit at.  The drives no longer poll PORTC while running, the DONE
+// functions only look at the running bits.  limit_hit has the same
+// bits as limit_status, the bits of an axis are cleared when it is
+// started again.
+	volatile unsigned char limit_hit = 0x00;		// Switches that stopped a drive
+	volatile long X_hit_location = 0;		// X location at the last X hit (signed 32 bit)
+	volatile long Y_hit_location = 0;		// Y location at the last Y hit (signed 32 bit)
+	volatile long Z_hit_location = 0;		// Z location at the last Z hit (signed 32 bit)
+
+// This function, X_LIMIT is called by the X step interrupt before
+// STEP is driven high (see main.c and DRIVE_GO in drive_start.c).  It
+// returns the switch bit if the X switch in the direction of travel is
+// made, after stopping Timer2 and the X-Drive.
+unsigned char X_LIMIT(void)
+{
+	unsigned char hit = ~(PORTC) & (RB0 ? 0x02 : 0x01);	// X-FFH clockwise, X-H counter clockwise
+
+	if(hit)
+	{
+		TMR2IE = 0; 	// No more X steps
+		TMR2ON = 0;
+		X_hit_location = POSITION(X_location_hi, X_location);
+		location_seq++;	// Hit location changed (see LOCATION in drive_start.c)
+		limit_hit |= hit;
+		limit_status |= hit;
+		system_status &= 0b11101111; // X-Drive not running, AXIS_DRIVE_DONE finishes
+	}
+	return hit;
+
+}	// End of X_LIMIT function
+
+// This function, Y_LIMIT is X_LIMIT for the Y drive (Timer4).
+unsigned char Y_LIMIT(void)
+{
+	unsigned char hit = ~(PORTC) & (RA4 ? 0x08 : 0x04);	// Y-FFH clockwise, Y-H counter clockwise
+
+	if(hit)
+	{
+		TMR4IE = 0; 	// No more Y steps
+		TMR4ON = 0;
+		Y_hit_location = POSITION(Y_location_hi, Y_location);
+		location_seq++;	// Hit location changed (see LOCATION in drive_start.c)
+		limit_hit |= hit;
+		limit_status |= hit;
+		system_status &= 0b11011111; // Y-Drive not running, AXIS_DRIVE_DONE finishes
+	}
+	return hit;
+
+}	// End of Y_LIMIT function
+
+// This function, Z_LIMIT is X_LIMIT for the Z drive (Timer6).  With
+// STEP from CCP3 (see Z_PWM_STEP in drive_pwm.c) it is called just
+// after the step, the caller turns the PWM off.
+unsigned char Z_LIMIT(void)
+{
+	unsigned char hit = ~(PORTC) & (RB4 ? 0x20 : 0x10);	// Z-FFH clockwise, Z-H counter clockwise
+
+	if(hit)
+	{
+		TMR6IE = 0; 	// No more Z steps
+		TMR6ON = 0;
+		Z_hit_location = POSITION(Z_location_hi, Z_location);
+		location_seq++;	// Hit location changed (see LOCATION in drive_start.c)
+		limit_hit |= hit;
+		limit_status |= hit;
+		system_status &= 0b10111111; // Z-Drive not running, AXIS_DRIVE_DONE finishes
+	}
+	return hit;
+
+}	// End of Z_LIMIT function
+
+//  This is the serial interface to read the switches that stopped a
+//  drive and where.
+//  The format is:
+//	[0] [1] 'RH' - Read limit Hits
+//  returns 13 chars: limit_hit, X_hit_location, Y_hit_location and
+//  Z_hit_location, each signed 32 bit MSB first
+void read_limit_hit(void)
+{
+	unsigned char seq;
+	unsigned char hit;
+	long at[AXIS_COUNT];
+
+	do	// Set together by the step interrupts (see LOCATION in drive_start.c)
+	{
+		seq = location_seq;
+		hit = limit_hit;
+		for( unsigned char a = 0; a < AXIS_COUNT; a++)
+			at[a] = *axes[a].hit_location;
+	} while(seq != location_seq);
+
+	SendStart(13);			// Returning thirteen chars
+	SendByte(hit);
+	for( unsigned char a = 0; a < AXIS_COUNT; a++)
+		tx_location(at[a]);	// (see drive_start.c)
+	SendEnd();
+}// End read_limit_hit function
+
+//  This is the serial interface to read all of the state in one frame
+//  in place of 'RPX', 'RPY', 'RPZ', 'RS' and 'RL'.  The format is:
+//	[0] [1] 'RA' - Read All
+//  returns 30 chars: X, Y and Z_location, X, Y and Z_new_location
+//  (each signed 32 bit, MSB first, as 'REX'), system_status, limit
+//  switches (as 'RL'), limit_status, working_vref, motion_job,
+//  motion_queue_count
+//  What the step interrupts change is copied again until no step came
+//  in (see LOCATION in drive_start.c) so it is all from the same step,
+//  the rest is sent as it is read.
+void read_all_status(void)
+{
+	long at[AXIS_COUNT];
+	unsigned char status;
+	unsigned char limits;
+	unsigned char hits;
+	unsigned char seq;
+
+	do	// Locations and running bits from the same step
+	{
+		seq = location_seq;
+		for( unsigned char a = 0; a < AXIS_COUNT; a++)
+			at[a] = POSITION(*axes[a].location_hi, *axes[a].location);
+		status = system_status;
+		limits = ~(PORTC);
+		hits = limit_status;
+	} while(seq != location_seq);
+
+	SendStart(30);	// Returning 30 chars
+	for( unsigned char a = 0; a < AXIS_COUNT; a++)
+		tx_location(at[a]);	// (see drive_start.c)
+	for( unsigned char a = 0; a < AXIS_COUNT; a++)
+		tx_location(POSITION(*axes[a].new_location_hi, *axes[a].new_location));
+	SendByte(status);
+	SendByte(limits);
+	SendByte(hits);
+	SendByte(working_vref);
+	SendByte(motion_job);
+	SendByte(motion_queue_count);
+	SendEnd();
+}// End read_all_status function
+	
+// The following will read the status of XYZ limits
+void read_limit_status(void)
+{
+	limit_status = ~(PORTC);
+}// End read_limit_status function	
+
+// The following will read the status of XYZ limits for transmit
+void tx_read_limit_status(void)
+{
+	SendStart(1);			// Returning one char
+	SendByte(~(PORTC));
+	SendEnd();
+}// End read_limit_status function	
+
+// The Following will clear the limit status
+void clear_limit_status(void)
+{
+	limit_status = 0b00000000; // Clear Limit Status	
+	limit_hit = 0b00000000;
+}// End clear_limit_status function
+
+// Bits of the following register will contain System Status Information
+// as follows:
+// 
+//	Errors:
+//	0bXXXX XXX1 	System Error
+//	0bXXXX XX1Y 	Invalid Serial Command
+//	0bXXXX X1XY 	VREF value Error
+//	0bXXXX 1XXY 	Period value Error
+//	Status:
+//	0bXXX1 XXXX 	X-Drive Running
+// 	0bXX1X XXXX 	Y-Drive Running
+// 	0bX1XX XXXX 	Z-Drive Running
+// 	0b1XXX XXXY 	Motion Queue Full (see motion.c)
+	volatile unsigned char system_status = 0x00; 	// Contains System Status Info
+	
+// The following will read the system status
+void read_system_status(void)
+{
+	SendStart(1);			// Returning one char
+	SendByte(system_status);
+	SendEnd();
+}// End read_system_status function	
+
+// The Following will clear the limit status
+void clear_system_status(void)
+{
+	system_status = 0b00000000; // Clear Limit Status	
+}// End read_system_status function
+
@@ -1,119 +1,215 @@
-/*
- * vref.c
- *
- * Sets reference voltage for the chopper circuit of the L297.
+/*
+ * vref.c
+ *
+ * Sets reference voltage for the chopper circuit of the L297.
  * 
-*/
-
-#include <pic.h>
-#include "globals.h";
-
-volatile unsigned char X_vref = 0x11;	// X Drive Ref Limit (2.8 Amp Motor)
-volatile unsigned char Y_vref = 0x11;	// Y Drive Ref Limit (2.8 Amp Motor)
-volatile unsigned char Z_vref = 0x06;	// Z Drive Ref Limit (1 Amp Motor)
-
-volatile unsigned char working_vref = 0x00;	// Current Ref executing
-unsigned char vref_limit = 0x1C;			// L297 Ref Limit ( 4.7 Amps * 0.2 oHms = 0.94 Volts)
-
-// This function, SET_VREF (set voltage reference) sets the
-// reference voltage for chopper circuit. A voltage applied 
-// to this pin determines the peak load current. DACOUT (RA2) 
-// is used to provide this reference.  This pin has a 3 Volt 
-// limit on the L297. The value used by this function is:
-//
-//    vref = (Stepper I Limit) * 0.2 Ohms 
-// 
-// The reference used to produce DACOUT is the fixed voltage 
-// reference (FVR) of 1.024 volts which was setup on power-up 
-// of the PIC.  This was used because ripples on VDD could be 
-// transfered to DACOUT where the internal reference would not 
-// be harmed. Also, DACOUT has a limited amount of resolution 
-// (32 steps 0-31) so dividing it with respect to a reference 
-// closer to the limit of design limit (4.7 amps, ~ 0.94 Volts)
-// results in better step resolution.  This function uses a 
-// fixed delay to allow for the reference to become stable.  This
-// delay uses Timer0 and the interrupt routine so RX commands 
-// can still be captured.
-void SET_VREF(void)
-{
-	if( working_vref <= vref_limit)	// Verify <= ~0.94 Volts (0.9249 V)
-	{
-		DACCON1 = working_vref;	// VOLTAGE REFERENCE CONTROL REGISTER 1
-								//    DACR<4:0>
-	
-		DACCON0 = 0b11101000;	//  VOLTAGE REFERENCE CONTROL REGISTER 0
-								//  DACEN DACLPS DACOE  DACPSS<1:0>  DACNSS
-								//  Turn on DACOUT and use FVR
-								// Set to look for ( TMR0IF && ms_Timer_flag) interrupt
-	
-		msDelay(250);	// Delay for settle
-						
-		system_status &= 0b11111011;// Clear VREF value Error
-	}
-	else
-		system_status |= 0b00000101;// Set VREF value Error
-
-}	// End of SET_VREF function
-
-//  This is the serial interface to set or write X_Vref.  The format is:
-//	[0] [1] [2] 'WVX': Write Vref for X Drive
-//  [3] vref update value ( 0 to 31 is the range but must be < vref_limit)
-//  SET_VREF will handle the limit test.  
-void write_X_VREF(void)
-{
-	X_vref = rxfifo[3];	// update
-}	// End of write_X_VREF function	
-
-//  This is the serial interface to set or write Y_Vref.  The format is:
-//	[0] [1] [2] 'WVY': Write Vref for Y Drive
-//  [3] vref update value ( 0 to 31 is the range but must be < vref_limit)
-//  SET_VREF will handle the limit test.
-void write_Y_VREF(void)
-{
-	Y_vref = rxfifo[3];	// update
-}	// End of write_Y_VREF function
-
-//  This is the serial interface to set or write Z_Vref.  The format is:
-//	[0] [1] [2] 'WVZ': Write Vref for Z Drive
-//  [3] vref update value ( 0 to 31 is the range but must be < vref_limit)
-//  SET_VREF will handle the limit test.  
-void write_Z_VREF(void)
-{
-	Z_vref = rxfifo[3];	// update
-}	// End of write_Z_VREF function		
-
-//  This reads working_vref.  The format is: 
-//  [0] 1 				(transmit size)
-//  [1] vref_working 	(current vref setting)
-void read_VREF(void)
-{
-	txfifo[0] = 1;				// Returning 1 char
-	txfifo[1] = working_vref; 	// reference voltage for chopper circuit
-}	// End of read_VREF function		
-
-//  This reads X_vref.  The format is: 
-//  [0] 1 		(transmit size)
-//  [1] X_vref 	(current vref setting)
-void read_X_VREF(void)
-{
-	txfifo[0] = 1;			// Returning 1 char
-	txfifo[1] = X_vref; 	// reference voltage for chopper circuit
-}	// End of read_X_VREF function		
-
-//  This reads Y_vref.  The format is: 
-//  [0] 1 		(transmit size)
-//  [1] X_vref 	(current vref setting)
-void read_Y_VREF(void)
-{
-	txfifo[0] = 1;			// Returning 1 char
-	txfifo[1] = Y_vref; 	// reference voltage for chopper circuit
-}	// End of read_Y_VREF function
-
-//  This reads Z_vref.  The format is: 
-//  [0] 1 		(transmit size)
-//  [1] Z_vref 	(current vref setting)
-void read_Z_VREF(void)
-{
-	txfifo[0] = 1;			// Returning 1 char
-	txfifo[1] = Z_vref; 	// reference voltage for chopper circuit
-}	// End of read_Z_VREF function		
\ No newline at end of file
+*/
+
+#include <pic.h>
+#include "globals.h"
+
+volatile unsigned char X_vref = 0x11;	// X Drive Ref Limit (2.8 Amp Motor)
+volatile unsigned char Y_vref = 0x11;	// Y Drive Ref Limit (2.8 Amp Motor)
+volatile unsigned char Z_vref = 0x06;	// Z Drive Ref Limit (1 Amp Motor)
+
+volatile unsigned char working_vref = 0x00;	// Current Ref executing
+unsigned char vref_limit = 0x1C;			// L297 Ref Limit ( 4.7 Amps * 0.2 oHms = 0.94 Volts)
+
+volatile unsigned int X_vref_settle = 250;	// mSec for DACOUT to settle on X_vref
+volatile unsigned int Y_vref_settle = 250;	// mSec for DACOUT to settle on Y_vref
+volatile unsigned int Z_vref_settle = 250;	// mSec for DACOUT to settle on Z_vref
+
+volatile unsigned int vref_settle_ms = 0;	// mSec left before DACOUT is stable (see isr)
+volatile bit vref_ready = 1;				// DACOUT is stable
+volatile unsigned long vref_wait_ms = 0;	// mSec drives were held waiting on DACOUT (see isr)
+
+volatile bit X_vref_pwm = 0;	// X VREF from CCP2 PWM on RB3 instead of DACOUT
+volatile bit vref_locked = 0;	// DACOUT set for several drives (see HOME in drive_home.c)
+
+// This function, SET_VREF (set voltage reference) sets the
+// reference voltage for chopper circuit. A voltage applied 
+// to this pin determines the peak load current. DACOUT (RA2) 
+// is used to provide this reference.  This pin has a 3 Volt 
+// limit on the L297. The value used by this function is:
+//
+//    vref = (Stepper I Limit) * 0.2 Ohms 
+// 
+// The reference used to produce DACOUT is the fixed voltage 
+// reference (FVR) of 1.024 volts which was setup on power-up 
+// of the PIC.  This was used because ripples on VDD could be 
+// transfered to DACOUT where the internal reference would not 
+// be harmed. Also, DACOUT has a limited amount of resolution 
+// (32 steps 0-31) so dividing it with respect to a reference 
+// closer to the limit of design limit (4.7 amps, ~ 0.94 Volts)
+// results in better step resolution.  This function does not
+// wait for the reference to become stable.  It clears vref_ready
+// and the Timer0 tick counts settle mSec down and sets it again.
+// A drive started in the meantime is held until then (see
+// DRIVE_GO in drive_start.c) so the settle time runs at the same
+// time as the RESET/Enable delay and the commands that follow.
+void SET_VREF(unsigned int settle)
+{
+	if( working_vref <= vref_limit)	// Verify <= ~0.94 Volts (0.9249 V)
+	{
+		DACCON1 = working_vref;	// VOLTAGE REFERENCE CONTROL REGISTER 1
+								//    DACR<4:0>
+	
+		DACCON0 = 0b11101000;	//  VOLTAGE REFERENCE CONTROL REGISTER 0
+								//  DACEN DACLPS DACOE  DACPSS<1:0>  DACNSS
+								//  Turn on DACOUT and use FVR
+
+		if(settle)
+		{
+			GIE = 0;
+			vref_settle_ms = settle;	// Counted down by Timer0 (see isr)
+			vref_ready = 0;
+			GIE = 1;
+		}
+						
+		system_status &= 0b11111011;// Clear VREF value Error
+	}
+	else
+		system_status |= 0b00000101;// Set VREF value Error
+
+}	// End of SET_VREF function
+
+// The X drive can have its own reference, so it runs at X_vref while
+// Y and Z share DACOUT (see XYZ_DRIVE in drive_xyz.c), and switching
+// between X and Y/Z moves does not wait on DACOUT settling.  This needs
+// the board option where the X L297 CONTROL input is strapped low and
+// RB3 goes through a two pole RC filter (corner near 50 Hz) to the X
+// VREF input instead of DACOUT.  Only X can do this: the other CCP
+// pins of this PIC are the limit switches, TX, Y DIR and Z STEP.
+//
+// CCP2 (on RB3, APFCON CCP2SEL) runs PWM from Timer2, the X step timer,
+// so the PWM period follows PR2 (488 Hz to 62.5 kHz, the pre-scale is
+// at most 1:64) and the duty is scaled with it to keep the filtered
+// level at X_vref.  The level is VDD (5 Volts) * duty where DACOUT is
+// 1.024 Volts * X_vref / 32, so the 10 bit duty is
+//
+//    (PR2 + 1) * 4 * X_vref * 1.024 / (32 * 5) = (PR2 + 1) * X_vref * 105 / 4096
+//
+// The reference follows VDD rather than the FVR, so VDD ripple gets
+// through to it.
+
+// This function, X_VREF_PWM_START starts CCP2 at X_vref and Timer2
+// (interrupt off) so the filter can settle before the first STEP.  The
+// settle time is counted with the DACOUT one (see DRIVE_GO in
+// drive_start.c).  PR2 and T2CON have to be set first.
+void X_VREF_PWM_START(void)
+{
+	unsigned int duty;	// 10 bit CCP2 duty
+
+	if( X_vref <= vref_limit)	// Verify <= ~0.94 Volts (0.9249 V)
+	{
+		duty = (unsigned int)(((unsigned long)(PR2 + 1) * X_vref * 105) >> 12);
+
+		CCPTMRS0 &= 0b11110011;	// C2TSEL = 00, CCP2 PWM from Timer2
+		APFCON |= 0b00000001;	// CCP2SEL, CCP2 on RB3
+		CCPR2L = (unsigned char)(duty >> 2);
+		CCP2CON = 0b00001100 | (unsigned char)((duty & 0x03) << 4);	// PWM mode, DC2B
+
+		TMR2IE = 0;	// No step until DRIVE_GO
+		TMR2IF = 0;
+		TMR2ON = 1;	// CCP2 PWM running
+
+		GIE = 0;
+		if(X_vref_settle > vref_settle_ms)
+		{
+			vref_settle_ms = X_vref_settle;	// Counted down by Timer0 (see isr)
+			vref_ready = 0;
+		}
+		GIE = 1;
+
+		system_status &= 0b11111011;// Clear VREF value Error
+	}
+	else
+		system_status |= 0b00000101;// Set VREF value Error
+
+}	// End of X_VREF_PWM_START function
+
+// This function, X_RAMP_VREF_PWM scales the CCP2 duty to a new PR2.  It
+// is called from the isr after the X or XYZ ramp has changed PR2 (see
+// X_RAMP in drive_ramp.c and XYZ_STEP in drive_xyz.c), the new duty is
+// used from the next PWM period on.
+void X_RAMP_VREF_PWM(void)
+{
+	unsigned int duty;	// 10 bit CCP2 duty
+
+	duty = (unsigned int)(((unsigned long)(PR2 + 1) * X_vref * 105) >> 12);
+
+	CCPR2L = (unsigned char)(duty >> 2);
+	CCP2CON = 0b00001100 | (unsigned char)((duty & 0x03) << 4);	// PWM mode, DC2B
+
+}	// End of X_RAMP_VREF_PWM function
+
+//  This is the serial interface to select the X reference.  The format is:
+//	[0] [1] [2] 'WRX': Write Reference for X Drive
+//  [3] 0 = DACOUT (shared with Y and Z), 1 = CCP2 PWM on RB3 (board option)
+//  Used from the next X or XYZ drive on.
+void write_X_vref_source(void)
+{
+	if(rx_arg > 1)
+		system_status |= 0x03; 	// Invalid command
+								// Error
+	else
+		X_vref_pwm = rx_arg;
+}	// End of write_X_vref_source function
+
+//  This is the serial interface to set or write a drive's vref.  The format is:
+//	[0] [1] [2] 'WVX', 'WVY' or 'WVZ': Write Vref
+//  [3] vref update value ( 0 to 31 is the range but must be < vref_limit)
+//  SET_VREF will handle the limit test.  
+void write_axis_VREF(const axis_t *axis)
+{
+	*axis->vref = rx_arg;	// update
+}	// End of write_axis_VREF function	
+
+//  This reads working_vref.  The format is: 
+//  [0] 1 				(transmit size)
+//  [1] vref_working 	(current vref setting)
+void read_VREF(void)
+{
+	SendStart(1);				// Returning 1 char
+	SendByte(working_vref); 	// reference voltage for chopper circuit
+	SendEnd();
+}	// End of read_VREF function		
+
+//  This reads a drive's vref ('RVX', 'RVY' or 'RVZ').  The format is: 
+//  [0] 1 		(transmit size)
+//  [1] vref 	(current vref setting)
+void read_axis_VREF(const axis_t *axis)
+{
+	SendStart(1);			// Returning 1 char
+	SendByte(*axis->vref); 	// reference voltage for chopper circuit
+	SendEnd();
+}	// End of read_axis_VREF function		
+
+//  This is the serial interface to set a drive's Vref settle time.  The format is:
+//	[0] [1] [2] 'WTX', 'WTY' or 'WTZ': Write settle Time for Vref
+//  [3] vref_settle MSB (mSec)
+//  [4] vref_settle LSB
+void write_settle(const axis_t *axis)
+{
+	*axis->vref_settle = rx_arg;
+}	// End of write_settle function
+
+//  This reads the time drives were held waiting on Vref since power up.
+//  The format is:
+//  [0] 4 				(transmit size)
+//  [1] - [4] vref_wait_ms	(mSec, MSB first)
+void read_vref_wait(void)
+{
+	unsigned long wait;
+
+	GIE = 0;
+	wait = vref_wait_ms;	// Counted by Timer0 (see isr)
+	GIE = 1;
+
+	SendStart(4);			// Returning 4 chars
+	SendByte((unsigned char)(wait >> 24));
+	SendByte((unsigned char)(wait >> 16));
+	SendByte((unsigned char)(wait >> 8));
+	SendByte((unsigned char)wait);
+	SendEnd();
+}	// End of read_vref_wait function